@@ -25,6 +25,19 @@ defmodule Whisper do
     # postprocess
   end
 
+  @doc """
+  Feed the 16kHz PCM chunk (s16le) and recognize the latest 30 seconds.
+  The log-mel features are computed incrementally in tfl_interp.
+  """
+  def apply_stream(pcm, handle \\ 0) do
+    {:ok, _} = NNInterp.put_audio(__MODULE__, handle, 0, pcm, format: :s16)
+
+    __MODULE__
+      |> NNInterp.invoke()
+      |> NNInterp.get_output_tensor(0)
+      |> then(fn output -> (for <<id::32-little <- output>>, do: id) end)
+  end
+
   # basic decoder to convert from ids to string.
   @u0000  Enum.concat([?!..?~, ?¡..?¬, ?®..?ÿ])
   @u2b    Map.new(Enum.map(@u0000, &{<<&1::utf8>>, &1}) ++ Enum.with_index(Enum.reject(0..255, &(&1 in @u0000)), &{<<&2+0x100::utf8>>, &1}))
@@ -99,21 +99,24 @@ defmodule TflInterp do
 
         nn_memo = if is_function(nn_memo), do: nn_memo.(), else: nn_memo
 
-        {:ok, %{port: port, itempl: nn_inputs, otempl: nn_outputs, memo: nn_memo}}
+        {:ok, %{port: port, itempl: nn_inputs, otempl: nn_outputs, memo: nn_memo, tag: 0, pending: %{}}}
       end
 
       def session() do
         %TflInterp{module: __MODULE__}
       end
 
-      def handle_call(cmd_line, _from, state) when is_binary(cmd_line) do
-        Port.command(state.port, cmd_line)
-        response = receive do
-          {_, {:data, <<result::binary>>}} -> {:ok, result}
-        after
-          Keyword.get(unquote(opts), :timeout, 300000) -> {:timeout}
-        end
-        {:reply, response, state}
+      # the request is tagged and the reply is matched by the tag, so the
+      # server can skip/abort the request whose deadline has passed.
+      def handle_call({:cmd, cmd_line, deadline, stream, priority, tenant, model}, from, state) do
+        tag = rem(state.tag, 0x7FFFFFFF) + 1
+        Port.command(state.port, <<tag::little-integer-32, deadline::little-integer-32, stream::little-integer-32, priority::little-integer-16, tenant::little-integer-16, model::little-integer-32>> <> cmd_line)
+        timer = Process.send_after(self(), {:timeout, tag}, Keyword.get(unquote(opts), :timeout, 300000))
+        {:noreply, %{state | tag: tag, pending: Map.put(state.pending, tag, {from, timer})}}
+      end
+
+      def handle_call(cmd_line, from, state) when is_binary(cmd_line) do
+        handle_call({:cmd, cmd_line, 0, 0, 0, 0, 0}, from, state)
       end
 
       def handle_call({:itempl, index}, _from, %{itempl: template}=state) do
@@ -128,6 +131,42 @@ defmodule TflInterp do
         {:reply, {:ok, memo}, state}
       end
 
+      def handle_cast({:cancel, tag}, state) do
+        Port.command(state.port, <<0::little-integer-32, 0::little-integer-32, 0::little-integer-32, 0::little-integer-32, 0::little-integer-32, 0xFFFFFFFF::little-integer-32, tag::little-integer-32>>)
+        {:noreply, state}
+      end
+
+      def handle_info({port, {:data, <<tag::little-integer-32, status::little-signed-integer-32, result::binary>>}}, %{port: port}=state) do
+        case Map.pop(state.pending, tag) do
+          {{from, timer}, pending} ->
+            Process.cancel_timer(timer)
+            GenServer.reply(from, case status do
+                0   -> {:ok, result}
+                -12 -> {:error, :deadline}
+                -13 -> {:error, :cancelled}
+                -14 -> {:error, :dropped}
+                -15 -> {:error, :rejected}
+                -16 -> {:error, :no_model}
+                -17 -> {:error, :loading}
+                -18 -> {:error, :reloaded}
+                _   -> {:error, status}
+              end)
+            {:noreply, %{state | pending: pending}}
+          {nil, _} ->
+            {:noreply, state}
+        end
+      end
+
+      def handle_info({:timeout, tag}, state) do
+        case Map.pop(state.pending, tag) do
+          {{from, _timer}, pending} ->
+            GenServer.reply(from, {:timeout})
+            handle_cast({:cancel, tag}, %{state | pending: pending})
+          {nil, _} ->
+            {:noreply, state}
+        end
+      end
+
       def terminate(_reason, state) do
         Port.close(state.port)
       end
@@ -198,7 +237,7 @@ defmodule TflInterp do
   """
   def info(mod) do
     cmd = 0
-    case GenServer.call(mod, <<cmd::little-integer-32>>, @timeout) do
+    case call(mod, <<cmd::little-integer-32>>) do
       {:ok, result} ->  Jason.decode(result)
       any -> any
     end
@@ -229,7 +268,7 @@ defmodule TflInterp do
 
   def set_input_tensor(mod, index, bin, opts) when is_atom(mod) do
     cmd = 1
-    case GenServer.call(mod, <<cmd::little-integer-32>> <> input_tensor(index, bin, opts), @timeout) do
+    case call(mod, <<cmd::little-integer-32>> <> input_tensor(index, bin, opts)) do
       {:ok, result} ->  Jason.decode(result)
       any -> any
     end
@@ -253,6 +292,38 @@ defmodule TflInterp do
     <<size::little-integer-32, index::little-integer-32, dtype::little-integer-32, lo::little-float-32, hi::little-float-32, bin::binary>>
   end
 
+  @doc """
+  Overwrite a sub-region of the input tensor on the interpreter (stateful mode).
+
+  The rest of the input tensor keeps the previous data, so the streaming
+  workloads - ex. sliding audio window, inpainting mask region - send only
+  the changed region.
+
+  ## Parameters
+
+    * mod   - modules' names
+    * index - index of input tensor in the model
+    * bin   - flat binary of the region
+    * slice - byte offset in the tensor, or {start, size} N-d slice. ex. {{0, 100, 0}, {1, 16, 80}}
+  """
+  def set_input_slice(mod, index, bin, slice) when is_atom(mod) do
+    {rank, offset, dims} = case slice do
+      offset when is_integer(offset) ->
+        {0, offset, <<>>}
+      {start, size} ->
+        dims = Tuple.to_list(start) ++ Tuple.to_list(size)
+        {tuple_size(start), 0, (for x <- dims, into: <<>>, do: <<x::little-integer-32>>)}
+    end
+    size = byte_size(bin)
+
+    cmd = 21
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32, size::little-integer-32, rank::little-integer-32, offset::little-integer-32>> <> dims <> bin) do
+      {:ok, result} ->  Jason.decode(result)
+      any -> any
+    end
+    mod
+  end
+
   @doc """
   Put flat binaries to the input tensors on the interpreter.
 
@@ -267,6 +338,302 @@ defmodule TflInterp do
     |> Enum.reduce(mod, fn {item, i}, mod -> set_input_tensor(mod, i, item) end)
   end
 
+  @doc """
+  Put a raw image frame to the input tensor on the interpreter.
+
+  The frame at native resolution is cropped, resized, letterboxed and
+  normalized straight into the input tensor.
+
+  ## Parameters
+
+    * mod   - modules' names
+    * index - index of input tensor in the model
+    * bin   - raw image frame - HWC u8 binary
+    * {width, height, channel} - shape of the frame
+    * opts
+      * fit:    - :stretch (default) or :letterbox (top-left aligned)
+      * filter: - :bilinear (default), :area or :nearest
+      * layout: - layout of the input tensor; :nhwc (default) or :nchw
+      * bgr:    - swap R and B (default: false)
+      * roi:    - crop region {x0, y0, x1, y1} in the frame (default: whole frame)
+      * pad:    - pixel value of the letterbox padding (default: 0)
+      * range:  - {lo, hi} map the pixel [0, 255] to [lo, hi] (default: {0.0, 255.0})
+      * gauss:  - {{mean, std}, ..} normalize each channel by (x - mean)/std. it overrides `range:`.
+
+  ## Returns
+    {:ok, [rx, ry]} - aspect ratio of the letterbox. see adjust2letterbox/2.
+  """
+  def set_input_image(mod, index, bin, {width, height, channel}, opts \\ []) do
+    size = byte_size(bin)
+
+    cmd = 11
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32>> <> image_opts(opts) <> <<width::little-integer-32, height::little-integer-32, channel::little-integer-32, size::little-integer-32>> <> bin) do
+      {:ok, result} ->
+        case Jason.decode(result) do
+          {:ok, %{"status" => 0, "aspect" => aspect}} -> {:ok, aspect}
+          {:ok, %{"status" => status}} -> {:error, status}
+          any -> any
+        end
+      any -> any
+    end
+  end
+
+  @doc """
+  Put a compressed image (JPEG/PNG) to the input tensor on the interpreter.
+
+  The image is decoded inside tfl_interp and goes through the same path as
+  set_input_image/5, so only the compressed bytes cross the port.
+
+  ## Parameters
+
+    * mod   - modules' names
+    * index - index of input tensor in the model
+    * bin   - JPEG/PNG binary. ex. File.read!("dog.jpg")
+    * opts  - see set_input_image/5
+
+  ## Returns
+    {:ok, [rx, ry], {width, height, channel}} - aspect ratio of the letterbox and shape of the decoded image.
+  """
+  def set_input_encoded_image(mod, index, bin, opts \\ []) do
+    size = byte_size(bin)
+
+    cmd = 12
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32>> <> image_opts(opts) <> <<size::little-integer-32>> <> bin) do
+      {:ok, result} ->
+        case Jason.decode(result) do
+          {:ok, %{"status" => 0, "aspect" => aspect, "frame" => [w, h, c]}} -> {:ok, aspect, {w, h, c}}
+          {:ok, %{"status" => status}} -> {:error, status}
+          any -> any
+        end
+      any -> any
+    end
+  end
+
+  @doc """
+  Put an image frame to the frame cache on the interpreter.
+
+  The frame is uploaded once under the handle, and run_rois/5 pulls the crops
+  from it. The same handle is overwritten by the next put_frame/4.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * handle - integer handle of the frame
+    * bin    - raw HWC u8 binary, or JPEG/PNG binary
+    * shape  - {width, height, channel} of the raw frame, or :encoded for JPEG/PNG
+
+  ## Returns
+    {:ok, {width, height, channel}}
+  """
+  def put_frame(mod, handle, bin, shape) do
+    {encoded, w, h, c} = case shape do
+      :encoded  -> {1, 0, 0, 0}
+      {w, h, c} -> {0, w, h, c}
+    end
+    size = byte_size(bin)
+
+    cmd = 13
+    case call(mod, <<cmd::little-integer-32, handle::little-integer-32, encoded::little-integer-32, w::little-integer-32, h::little-integer-32, c::little-integer-32, size::little-integer-32>> <> bin) do
+      {:ok, result} ->
+        case Jason.decode(result) do
+          {:ok, %{"status" => 0, "frame" => [w, h, c]}} -> {:ok, {w, h, c}}
+          {:ok, %{"status" => status}} -> {:error, status}
+          any -> any
+        end
+      any -> any
+    end
+  end
+
+  @doc """
+  Drop the image frame from the frame cache.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * handle - integer handle of the frame
+  """
+  def drop_frame(mod, handle) do
+    cmd = 14
+    case call(mod, <<cmd::little-integer-32, handle::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Run inference on the ROIs of the cached frame.
+
+  Every box is cropped from the cached frame, resized to the input tensor and
+  inferred. If the input tensor has the batch dimension N, N boxes are run in
+  one invoke.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * handle - integer handle of the frame
+    * index  - index of input tensor in the model
+    * boxes  - list of [x1, y1, x2, y2] normalized to the frame. ex. the result of NMS
+    * opts   - see set_input_image/5 (except `roi:`)
+
+  ## Returns
+    {:ok, [{[rx, ry], [output_bin, ..]}, ..]} - letterbox aspect and outputs of each box
+  """
+  def run_rois(mod, handle, index, boxes, opts \\ []) do
+    num_box = Enum.count(boxes)
+    boxes   = for [x1, y1, x2, y2] <- boxes, into: <<>>, do: <<x1::little-float-32, y1::little-float-32, x2::little-float-32, y2::little-float-32>>
+
+    cmd = 15
+    case call(mod, <<cmd::little-integer-32, handle::little-integer-32, index::little-integer-32>> <> image_opts(opts) <> <<num_box::little-integer-32>> <> boxes) do
+      {:ok, <<status::little-signed-integer-32>>} when status < 0 -> {:error, status}
+      {:ok, <<_::little-integer-32, results::binary>>} -> {:ok, decode_rois(results, [])}
+      any -> any
+    end
+  end
+
+  defp decode_rois(<<>>, acc), do: Enum.reverse(acc)
+  defp decode_rois(<<rx::little-float-32, ry::little-float-32, count::little-integer-32, rest::binary>>, acc) do
+    {outputs, rest} = Enum.map_reduce(1..count//1, rest, fn _, <<size::little-integer-32, tensor::binary-size(size), rest::binary>> ->
+      {tensor, rest}
+    end)
+    decode_rois(rest, [{[rx, ry], outputs} | acc])
+  end
+
+  # ImageOpts in preprocess.h
+  defp image_opts(opts) do
+    {x0, y0, x1, y1} = Keyword.get(opts, :roi, {0, 0, 0, 0})
+    fit = case Keyword.get(opts, :fit, :stretch) do
+      :stretch   -> 0
+      :letterbox -> 1
+    end
+    filter = case Keyword.get(opts, :filter, :bilinear) do
+      :bilinear -> 0
+      :area     -> 1
+      :nearest  -> 2
+    end
+    nchw = case Keyword.get(opts, :layout, :nhwc) do
+      :nhwc -> 0
+      :nchw -> 1
+    end
+    bgr = if Keyword.get(opts, :bgr, false), do: 1, else: 0
+    pad = Keyword.get(opts, :pad, 0) / 1
+
+    {mean, std} = case Keyword.get(opts, :gauss) do
+      nil ->
+        {lo, hi} = Keyword.get(opts, :range, {0.0, 255.0})
+        {List.duplicate(-lo*255.0/(hi - lo), 4), List.duplicate(255.0/(hi - lo), 4)}
+      gauss ->
+        gauss = Tuple.to_list(gauss)
+        last  = List.last(gauss)
+        gauss = gauss ++ List.duplicate(last, 4 - Enum.count(gauss))
+        {Enum.map(gauss, &elem(&1, 0)), Enum.map(gauss, &elem(&1, 1))}
+    end
+
+    <<x0::little-signed-integer-32, y0::little-signed-integer-32, x1::little-signed-integer-32, y1::little-signed-integer-32,
+      fit::little-integer-32, filter::little-integer-32, nchw::little-integer-32, bgr::little-integer-32, pad::little-float-32>>
+    <> (for x <- mean, into: <<>>, do: <<x::little-float-32>>)
+    <> (for x <- std,  into: <<>>, do: <<x::little-float-32>>)
+  end
+
+  @doc """
+  Put a flat binary to the tensor store on the interpreter.
+
+  Constant data - ex. latent vectors, masks, segment ids - crosses the port
+  only once, and is bound to the input tensor by bind_input/3.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * handle - integer handle of the tensor
+    * bin    - flat binary, cf. serialized tensor
+  """
+  def put_tensor(mod, handle, bin) do
+    size = byte_size(bin)
+
+    cmd = 16
+    case call(mod, <<cmd::little-integer-32, handle::little-integer-32, size::little-integer-32>> <> bin) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Bind the tensor in the store to the input tensor.
+
+  In the stateful mode, the input tensor keeps it across invokes until it is
+  overwritten. In the session mode, it is bound at the invoke.
+
+  ## Parameters
+
+    * mod    - modules' names or session.
+    * index  - index of input tensor in the model
+    * handle - integer handle of the tensor
+  """
+  def bind_input(mod, index, handle) when is_atom(mod) do
+    cmd = 17
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32, handle::little-integer-32>>) do
+      {:ok, result} ->  Jason.decode(result)
+      any -> any
+    end
+    mod
+  end
+
+  def bind_input(%TflInterp{inputs: inputs}=session, index, handle) do
+    dtype = 3
+    size  = 16 + 4
+    input = <<size::little-integer-32, index::little-integer-32, dtype::little-integer-32, 0.0::little-float-32, 0.0::little-float-32, handle::little-integer-32>>
+    %TflInterp{session | inputs: [input | inputs]}
+  end
+
+  @doc """
+  Keep the output tensor in the tensor store instead of returning it.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * index  - index of output tensor in the model
+    * handle - integer handle of the tensor
+  """
+  def keep_output(mod, index, handle) do
+    cmd = 18
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32, handle::little-integer-32>>) do
+      {:ok, result} ->  Jason.decode(result)
+      any -> any
+    end
+    mod
+  end
+
+  @doc """
+  Get the flat binary of the tensor in the store.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * handle - integer handle of the tensor
+  """
+  def get_tensor(mod, handle) do
+    cmd = 19
+    case call(mod, <<cmd::little-integer-32, handle::little-integer-32>>) do
+      {:ok, result} -> result
+      any -> any
+    end
+  end
+
+  @doc """
+  Drop the tensor from the store.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * handle - integer handle of the tensor
+  """
+  def drop_tensor(mod, handle) do
+    cmd = 20
+    case call(mod, <<cmd::little-integer-32, handle::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
   @doc """
   Get the flat binary from the output tensor on the interpreter.
 
@@ -279,7 +646,7 @@ defmodule TflInterp do
 
   def get_output_tensor(mod, index, _opts) when is_atom(mod) do
     cmd = 3
-    case GenServer.call(mod, <<cmd::little-integer-32, index::little-integer-32>>, @timeout) do
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32>>) do
       {:ok, result} -> result
       any -> any
     end
@@ -324,7 +691,7 @@ defmodule TflInterp do
   """
   def invoke(mod) when is_atom(mod) do
     cmd = 2
-    case GenServer.call(mod, <<cmd::little-integer-32>>, @timeout) do
+    case call(mod, <<cmd::little-integer-32>>) do
       {:ok, result} -> Jason.decode(result)
       any -> any
     end
@@ -335,7 +702,9 @@ defmodule TflInterp do
     cmd   = 4
     count = Enum.count(inputs)
     data  = Enum.reduce(inputs, <<>>, fn x,acc -> acc <> x end)
-    case GenServer.call(mod, <<cmd::little-integer-32, count::little-integer-32>> <> data, @timeout) do
+    case call(mod, <<cmd::little-integer-32, count::little-integer-32>> <> data) do
+      {:ok, <<code::little-signed-integer-32>>} when code < 0 ->
+          {:error, code}
       {:ok, <<count::little-integer-32, results::binary>>} ->
           if count > 0 do
               outputs = for <<size::little-integer-32, tensor::binary-size(size) <- results>> do tensor end
@@ -347,6 +716,53 @@ defmodule TflInterp do
     end
   end
 
+  @doc """
+  Invoke prediction on multiple sessions in one request.
+
+  The sessions are executed back-to-back on the interpreter and all outputs
+  come back in one reply, so N samples cost one round trip.
+
+  ## Parameters
+
+    * sessions - list of session structure of the same module.
+
+  ## Examples.
+
+    ```elixir
+      results = for bin <- input_bins do
+          session() |> TflInterp.set_input_tensor(0, bin)
+        end
+        |> TflInterp.run_many()
+        |> Enum.map(&TflInterp.get_output_tensor(&1, 0))
+    ```
+  """
+  def run_many([%TflInterp{module: mod} | _] = sessions) do
+    num  = Enum.count(sessions)
+    data = Enum.reduce(sessions, <<>>, fn %TflInterp{inputs: inputs}, acc ->
+      count = Enum.count(inputs)
+      Enum.reduce(inputs, acc <> <<count::little-integer-32>>, fn x,acc -> acc <> x end)
+    end)
+
+    cmd = 22
+    case call(mod, <<cmd::little-integer-32, num::little-integer-32>> <> data) do
+      {:ok, <<_num::little-integer-32, results::binary>>} -> decode_many(results, sessions, [])
+      any -> any
+    end
+  end
+
+  def run_many([]), do: []
+
+  defp decode_many(_, [], acc), do: Enum.reverse(acc)
+  defp decode_many(<<status::little-signed-integer-32, rest::binary>>, [_ | sessions], acc) when status < 0 do
+    decode_many(rest, sessions, [{:error, status} | acc])
+  end
+  defp decode_many(<<count::little-integer-32, rest::binary>>, [session | sessions], acc) do
+    {outputs, rest} = Enum.map_reduce(1..count//1, rest, fn _, <<size::little-integer-32, tensor::binary-size(size), rest::binary>> ->
+      {tensor, rest}
+    end)
+    decode_many(rest, sessions, [%TflInterp{session | outputs: outputs} | acc])
+  end
+
   @deprecated "Use invoke/1 instead"
   def run(x), do: invoke(x)
 
@@ -382,7 +798,7 @@ defmodule TflInterp do
     sigma           = Keyword.get(opts, :sigma, 0.0)
 
     cmd = 5
-    case GenServer.call(mod, <<cmd::little-integer-32, num_boxes::little-integer-32, box_repr::little-integer-32, num_class::little-integer-32, iou_threshold::little-float-32, score_threshold::little-float-32, sigma::little-float-32>> <> boxes <> scores, @timeout) do
+    case call(mod, <<cmd::little-integer-32, num_boxes::little-integer-32, box_repr::little-integer-32, num_class::little-integer-32, iou_threshold::little-float-32, score_threshold::little-float-32, sigma::little-float-32>> <> boxes <> scores) do
       {:ok, nil} -> :notfind
       {:ok, result} -> Jason.decode(result)
       any -> any
@@ -391,31 +807,847 @@ defmodule TflInterp do
 
 
   @doc """
-  Adjust NMS result to aspect of the input image. (letterbox)
+  Execute post processing: post-op chain on the output tensor.
 
-  ## Parameters:
+  The chain runs over the output tensor of the last inference, and only the
+  reduced result is returned. The labels are paired with the index if the
+  label file is given.
 
-    * nms_result - NMS result {:ok, result}
-    * [rx, ry] - aspect ratio of the input image
+  ## Parameters
+
+    * mod   - modules' names
+    * index - index of output tensor in the model
+    * ops   - list of post-op
+      * :softmax, {:softmax, axis} - softmax along the axis (default: -1)
+      * :sigmoid                   - sigmoid of every element
+      * :argmax, {:argmax, axis}   - argmax along the axis (default: -1)
+      * {:topk, k}, {:topk, k, axis} - top-k along the axis with indices (default: -1)
+      * {:threshold, th}           - keep only the elements greater than `th`
+      * {:cast, dtype}             - return the binary of `dtype` (:f32, :u8, :i8, :u16, :i16, :i32).
+                                     the index is put out if the chain has made it, otherwise the value.
+
+  ## Examples.
+
+    ```elixir
+      {:ok, %{"value" => score, "label" => label}} = TflInterp.postop(mod, 0, [:softmax, {:topk, 3}])
+    ```
   """
-  def adjust2letterbox(nms_result, aspect \\ [1.0, 1.0])
+  def postop(mod, index, ops) do
+    count = Enum.count(ops)
+    bin   = Enum.reduce(ops, <<>>, fn op,acc -> acc <> postop_op(op) end)
+    cast? = Enum.any?(ops, &match?({:cast, _}, &1))
+
+    cmd = 6
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32, count::little-integer-32>> <> bin) do
+      {:ok, ""} when cast? -> {:error, "postop"}
+      {:ok, result} when cast? -> {:ok, result}
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
 
-  def adjust2letterbox({:ok, result}, [rx, ry]) do
-    {
-      :ok,
-      Enum.reduce(Map.keys(result), result, fn key,map ->
-        Map.update!(map, key, &Enum.map(&1, fn [score, x1, y1, x2, y2, index] ->
-          x1 = if x1 < 0.0, do: 0.0, else: x1
-          y1 = if y1 < 0.0, do: 0.0, else: y1
-          x2 = if x2 > 1.0, do: 1.0, else: x2
-          y2 = if y2 > 1.0, do: 1.0, else: y2
-          [score, x1/rx, y1/ry, x2/rx, y2/ry, index]
-        end))
-      end)
-    }
+  defp postop_op(:softmax),             do: postop_op(0, -1, 0.0)
+  defp postop_op({:softmax, axis}),     do: postop_op(0, axis, 0.0)
+  defp postop_op(:sigmoid),             do: postop_op(1, -1, 0.0)
+  defp postop_op(:argmax),              do: postop_op(2, -1, 0.0)
+  defp postop_op({:argmax, axis}),      do: postop_op(2, axis, 0.0)
+  defp postop_op({:topk, k}),           do: postop_op(3, -1, k)
+  defp postop_op({:topk, k, axis}),     do: postop_op(3, axis, k)
+  defp postop_op({:threshold, th}),     do: postop_op(4, -1, th)
+  defp postop_op({:cast, dtype}),       do: postop_op(5, -1, dtype_code(dtype))
+
+  defp postop_op(code, axis, param) do
+    <<code::little-integer-32, axis::little-signed-integer-32, param::little-float-32>>
   end
 
-  def adjust2letterbox(nms_result, _), do: nms_result
+  # dtype code: TensorSpec::DType
+  defp dtype_code(:f32), do: 1
+  defp dtype_code(:u8),  do: 2
+  defp dtype_code(:i8),  do: 3
+  defp dtype_code(:u16), do: 4
+  defp dtype_code(:i16), do: 5
+  defp dtype_code(:i32), do: 6
+
+
+  @doc """
+  Execute post processing: decode the keypoints of pose models.
+
+  It decodes the keypoint tensor (ex. MoveNet {1,1,17,3}) or the heatmaps
+  (+ offset fields) into joint records, and rescales them to the aspect of
+  the input image in the same pass.
+
+  ## Parameters
+
+    * mod   - modules' names
+    * index - index of keypoint/heatmap tensor in the model
+    * opts
+      * mode:         - layout of the tensor
+         * :yxs          - [.., K, 3] {y, x, score} (default)
+         * :xys          - [.., K, 3] {x, y, score}
+         * :heatmap      - [1, H, W, K] heatmaps. the peak is refined to sub-pixel.
+         * :heatmap_nchw - [1, K, H, W] heatmaps.
+      * offset:       - index of offset tensor [1, H, W, 2K] {y.., x..} for heatmaps
+      * offset_scale: - scale to normalize the offset. ex. 1/input_width
+      * aspect:       - [rx, ry] aspect ratio of the input image (letterbox)
+
+  ## Returns
+    {:ok, [[[x, y, score], ..], ..]} - list of joints of each pose
+  """
+  def decode_keypoints(mod, index, opts \\ []) do
+    mode = case Keyword.get(opts, :mode, :yxs) do
+      :yxs          -> 0
+      :xys          -> 1
+      :heatmap      -> 2
+      :heatmap_nchw -> 3
+    end
+    offset       = Keyword.get(opts, :offset, -1)
+    offset_scale = Keyword.get(opts, :offset_scale, 1.0)
+    [rx, ry]     = Keyword.get(opts, :aspect, [1.0, 1.0])
+
+    cmd = 7
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32, mode::little-integer-32, offset::little-signed-integer-32, offset_scale::little-float-32, rx::little-float-32, ry::little-float-32>>) do
+      {:ok, result} ->
+        case Jason.decode(result) do
+          {:ok, %{"status" => status}} -> {:error, status}
+          any -> any
+        end
+      any -> any
+    end
+  end
+
+  @doc """
+  Execute post processing: compact the segmentation mask.
+
+  It makes the class-index mask from the probability map of the output tensor
+  and encodes it, so only a few bytes per pixel are returned.
+
+  ## Parameters
+
+    * mod   - modules' names
+    * index - index of output tensor in the model
+    * opts
+      * mode:      - how to make the mask
+         * :argmax    - class index of the max probability (default, up to 256 classes)
+         * {:threshold, channel, th} - 1 if the channel > th else 0
+      * layout:    - :nhwc (default) or :nchw
+      * encoding:  - encoding of the mask
+         * :raw     - u8 per pixel (default)
+         * :rle     - run-length: {value::u8, length::little-u16} per run
+         * :bitpack - 1 bit per pixel, MSB first (binary mask only:
+                      threshold, or argmax over up to 2 classes)
+
+  ## Returns
+    {:ok, {{height, width}, payload}}
+  """
+  def segment_mask(mod, index, opts \\ []) do
+    {mode, channel, th} = case Keyword.get(opts, :mode, :argmax) do
+      :argmax -> {0, 0, 0.0}
+      {:threshold, channel, th} -> {1, channel, th}
+    end
+    nchw = case Keyword.get(opts, :layout, :nhwc) do
+      :nhwc -> 0
+      :nchw -> 1
+    end
+    encoding = case Keyword.get(opts, :encoding, :raw) do
+      :raw     -> 0
+      :rle     -> 1
+      :bitpack -> 2
+    end
+
+    cmd = 8
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32, mode::little-integer-32, nchw::little-integer-32, channel::little-integer-32, th::little-float-32, encoding::little-integer-32>>) do
+      {:ok, <<h::little-integer-32, w::little-integer-32, payload::binary>>} -> {:ok, {{h, w}, payload}}
+      {:ok, _} -> {:error, "segment_mask"}
+      any -> any
+    end
+  end
+
+  @doc """
+  Decode the run-length encoded mask into u8 per pixel.
+
+  ## Parameters
+
+    * rle - payload of segment_mask/3 with `encoding: :rle`
+  """
+  def decode_rle(rle) do
+    for <<value::integer-8, run::little-integer-16 <- rle>>, into: <<>> do
+      :binary.copy(<<value>>, run)
+    end
+  end
+
+  @doc """
+  Execute post processing: extractive QA span search for BERT-style models.
+
+  It searches the best spans maximizing `start_logits[beg] + end_logits[end]`
+  over the tokens mapped to the context words.
+
+  ## Parameters
+
+    * mod   - modules' names
+    * {start_index, end_index} - index of output tensors: start/end logits
+    * token_map - token-to-word map; s32 binary or list. -1 = not a context word
+    * opts
+      * max_len:  - max answer length in tokens (default: 32)
+      * num_best: - number of spans to return (default: 5)
+
+  ## Returns
+    {:ok, [[beg_word, end_word, score, beg_token, end_token], ..]} - in descending order of score
+  """
+  def qa_span(mod, {start_index, end_index}, token_map, opts \\ []) do
+    token_map = if is_list(token_map),
+      do: (for x <- token_map, into: <<>>, do: <<x::little-signed-integer-32>>),
+      else: token_map
+    count    = div(byte_size(token_map), 4)
+    max_len  = Keyword.get(opts, :max_len, 32)
+    num_best = Keyword.get(opts, :num_best, 5)
+
+    cmd = 9
+    case call(mod, <<cmd::little-integer-32, start_index::little-integer-32, end_index::little-integer-32, max_len::little-integer-32, num_best::little-integer-32, count::little-integer-32>> <> token_map) do
+      {:ok, result} ->
+        case Jason.decode(result) do
+          {:ok, %{"status" => status}} -> {:error, status}
+          any -> any
+        end
+      any -> any
+    end
+  end
+
+  @doc """
+  Execute post processing: encode the float output tensor to the image.
+
+  It normalizes the output tensor to u8/u16 pixels, transposes NCHW to HWC
+  and optionally encodes it in QOI (lossless).
+
+  ## Parameters
+
+    * mod   - modules' names
+    * index - index of output tensor in the model
+    * opts
+      * range:    - {lo, hi} fixed range mapped to [0, max] (default: {0.0, 1.0}),
+                    or :minmax to use the per-frame min/max. ex. depth map
+      * layout:   - :nhwc (default) or :nchw
+      * dtype:    - :u8 (default) or :u16
+      * encoding: - :raw (default) or :qoi (u8 with 1, 3 or 4 channels, error otherwise)
+
+  ## Returns
+    {:ok, {{height, width, channel}, payload}}
+  """
+  def encode_image(mod, index, opts \\ []) do
+    {norm, lo, hi} = case Keyword.get(opts, :range, {0.0, 1.0}) do
+      :minmax  -> {1, 0.0, 0.0}
+      {lo, hi} -> {0, lo, hi}
+    end
+    nchw = case Keyword.get(opts, :layout, :nhwc) do
+      :nhwc -> 0
+      :nchw -> 1
+    end
+    dtype = dtype_code(Keyword.get(opts, :dtype, :u8))
+    encoding = case Keyword.get(opts, :encoding, :raw) do
+      :raw -> 0
+      :qoi -> 1
+    end
+
+    cmd = 10
+    case call(mod, <<cmd::little-integer-32, index::little-integer-32, nchw::little-integer-32, norm::little-integer-32, lo::little-float-32, hi::little-float-32, dtype::little-integer-32, encoding::little-integer-32>>) do
+      {:ok, <<h::little-integer-32, w::little-integer-32, c::little-integer-32, payload::binary>>} -> {:ok, {{h, w, c}, payload}}
+      {:ok, _} -> {:error, "encode_image"}
+      any -> any
+    end
+  end
+
+  @doc """
+  Adjust NMS result to aspect of the input image. (letterbox)
+
+  ## Parameters:
+
+    * nms_result - NMS result {:ok, result}
+    * [rx, ry] - aspect ratio of the input image
+  """
+  def adjust2letterbox(nms_result, aspect \\ [1.0, 1.0])
+
+  def adjust2letterbox({:ok, result}, [rx, ry]) do
+    {
+      :ok,
+      Enum.reduce(Map.keys(result), result, fn key,map ->
+        Map.update!(map, key, &Enum.map(&1, fn [score, x1, y1, x2, y2, index] ->
+          x1 = if x1 < 0.0, do: 0.0, else: x1
+          y1 = if y1 < 0.0, do: 0.0, else: y1
+          x2 = if x2 > 1.0, do: 1.0, else: x2
+          y2 = if y2 > 1.0, do: 1.0, else: y2
+          [score, x1/rx, y1/ry, x2/rx, y2/ry, index]
+        end))
+      end)
+    }
+  end
+
+  def adjust2letterbox(nms_result, _), do: nms_result
+
+  @doc """
+  Load the model into the interpreter process under the model id.
+
+  The model loads on a background thread. The requests to it return
+  `{:error, :loading}` until the end of loading, so they don't hold up the
+  requests to the other models. Use `wait: true` to reply after loading.
+
+  ## Parameters
+
+    * mod - modules' names
+    * id - model id (> 0)
+    * model - path of the model file
+    * opts
+      * :label - path of the class labels
+      * :wait - reply after loading (default: false)
+      * :thread - number of threads (default: the setting of the process)
+      * :split - batch split (default: the setting of the process)
+      * :staging - input slots (default: the setting of the process)
+  """
+  def load_model(mod, id, model, opts \\ []) do
+    label   = Keyword.get(opts, :label, "")
+    wait    = if Keyword.get(opts, :wait, false), do: 1, else: 0
+    thread  = Keyword.get(opts, :thread, 0)
+    split   = Keyword.get(opts, :split, 0)
+    staging = Keyword.get(opts, :staging, 0)
+
+    cmd = 23
+    case call(mod, <<cmd::little-integer-32, id::little-integer-32, wait::little-integer-32, thread::little-integer-32, split::little-integer-32, staging::little-integer-32, byte_size(model)::little-integer-32, byte_size(label)::little-integer-32>> <> model <> label) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Unload the model.
+
+  ## Parameters
+
+    * mod - modules' names
+    * id - model id
+  """
+  def unload_model(mod, id) do
+    cmd = 24
+    case call(mod, <<cmd::little-integer-32, id::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  List the models in the interpreter process.
+
+  ## Parameters
+
+    * mod - modules' names
+  """
+  def list_models(mod) do
+    cmd = 25
+    case call(mod, <<cmd::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Select the signature of a multi-signature model.
+
+  The following commands to the model work on the signature `key`, and the
+  index of the inputs/outputs is in the order of the signature's input/output
+  names listed by `info/1`. The signatures share one model mapping and its
+  weights. `key` "" selects the primary subgraph.
+
+  It raises if the signature can't be selected, so the following commands
+  don't silently run on the previous one.
+
+  ## Parameters
+
+    * mod - modules' names
+    * key - signature key
+
+  ## Examples.
+
+    ```elixir
+      output_bin =
+        __MODULE__
+        |> TflInterp.set_signature("encode")
+        |> TflInterp.set_input_tensor(0, input_bin)
+        |> TflInterp.invoke()
+        |> TflInterp.get_output_tensor(0)
+    ```
+  """
+  def set_signature(mod, key) do
+    cmd = 26
+    case call(mod, <<cmd::little-integer-32, byte_size(key)::little-integer-32, key::binary>>) do
+      {:ok, result} ->
+        case Jason.decode(result) do
+          {:ok, %{"status" => 0}} -> mod
+          {:ok, %{"status" => status}} ->
+            raise ArgumentError, "set_signature: no signature \"#{key}\" (status #{status})."
+          any ->
+            raise "set_signature: bad reply #{inspect(any)}."
+        end
+      any ->
+        raise "set_signature: #{inspect(any)}."
+    end
+  end
+
+  @doc """
+  Run the autoregressive loop in the interpreter.
+
+  The model is invoked up to `:max_steps` times, and the outputs are fed back
+  to the inputs between the steps without the round trip. The first step
+  takes the inputs set beforehand, and the last outputs can be read by
+  `get_output_tensor/2` after the loop.
+
+  ## Parameters
+
+    * mod  - modules' names
+    * opts - loop options
+      * :max_steps    - maximum number of steps (default: 1)
+      * :token_output - output index of the logits (argmax of the last row)
+                        or the token id (last axis 1)
+      * :token_input  - input index to write the token of the previous step
+                        (needs :token_output)
+      * :stop_token   - token id to end the loop
+      * :pos_input    - input index to write the position `pos + step`
+      * :pos          - position of the first step (default: 0)
+      * :bindings     - list of `{output_index, input_index}` to copy every step
+                        (KV caches, recurrent states)
+
+  Return `{:ok, tokens}` or `{:error, code}`.
+
+  ## Examples.
+
+    ```elixir
+      {:ok, tokens} =
+        __MODULE__
+        |> TflInterp.set_input_tensor(0, <<bos::little-integer-32>>)
+        |> TflInterp.loop(max_steps: 64, token_output: 0, token_input: 0,
+             stop_token: eos, bindings: [{1, 1}, {2, 2}])
+    ```
+  """
+  def loop(mod, opts \\ []) do
+    none = 0xFFFFFFFF
+    max_steps    = Keyword.get(opts, :max_steps, 1)
+    token_output = Keyword.get(opts, :token_output, none)
+    token_input  = Keyword.get(opts, :token_input, none)
+    stop_token   = Keyword.get(opts, :stop_token, -1)
+    pos_input    = Keyword.get(opts, :pos_input, none)
+    pos          = Keyword.get(opts, :pos, 0)
+    bindings     = Keyword.get(opts, :bindings, [])
+
+    binding_bin = for {output, input} <- bindings, into: <<>> do
+        <<output::little-integer-32, input::little-integer-32>>
+      end
+
+    cmd = 27
+    case call(mod, <<cmd::little-integer-32,
+                     max_steps::little-integer-32,
+                     token_output::little-integer-32,
+                     token_input::little-integer-32,
+                     stop_token::little-signed-integer-32,
+                     pos_input::little-integer-32,
+                     pos::little-signed-integer-32,
+                     Enum.count(bindings)::little-integer-32>> <> binding_bin) do
+      {:ok, <<count::little-signed-integer-32, _::binary>>} when count < 0 -> {:error, count}
+      {:ok, <<_count::little-integer-32, tokens::binary>>} ->
+        {:ok, for <<token::little-signed-integer-32 <- tokens>> do token end}
+      any -> any
+    end
+  end
+
+  @doc """
+  Define the model chaining pipeline.
+
+  The pipeline runs the graph of the registered models and the glue stages
+  end to end on one request. The stages are listed in the topological order
+  and refer to the tensors of the former stages by "stage:index" ("in:index"
+  is the inputs of the pipeline).
+
+    * model - `%{name: "det", model: id, inputs: %{"0" => "in:0"}, image: 0, image_opts: %{fit: "letterbox"}}`
+              run the model. `image` is the input index filled from the frame.
+    * nms   - `%{name: "nms", op: "nms", boxes: "det:0", scores: "det:1", box_repr: 2, iou: 0.5, score: 0.25, size: [640, 640]}`
+              select the boxes, and normalize them to the frame.
+              it outputs f32 [n, 6] {x1, y1, x2, y2, score, class}.
+    * roi   - `%{name: "emb", op: "roi", model: id, boxes: "nms", image: 0, image_opts: %{}}`
+              run the model on the crops of the frame. the outputs are stacked along the boxes.
+
+  `image_opts` takes "fit", "filter", "layout", "bgr", "pad", "mean" and "std"
+  (default: raw pixel values in NHWC).
+
+  With `parallel: true` in the spec, every stage runs on its own thread and
+  its own interpreter of the model (`threads:` of the stage), with bounded
+  queues of `queue:` jobs (default 2) between the stages. `run_pipeline/4` on
+  consecutive frames then overlaps the stages, and the throughput is that of
+  the slowest stage. The requests wait while the first queue is full.
+
+  ## Parameters
+
+    * mod  - modules' names
+    * id   - integer id of the pipeline
+    * spec - `%{stages: [stage..], outputs: ["stage:index"..]}`
+  """
+  def define_pipeline(mod, id, spec) do
+    spec = Jason.encode!(spec)
+
+    cmd = 28
+    case call(mod, <<cmd::little-integer-32, id::little-integer-32, byte_size(spec)::little-integer-32>> <> spec) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Run the pipeline on the inputs and the cached frame.
+
+  Only the outputs of the pipeline come back; the intermediate tensors stay in
+  the interpreter process.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * id     - integer id of the pipeline
+    * inputs - list of binaries referred as "in:index"
+    * opts
+      * :frame - handle of the frame cached by `put_frame/4`
+
+  ## Examples.
+
+    ```elixir
+      {:ok, _} = TflInterp.put_frame(__MODULE__, 0, jpeg, :encoded)
+      {:ok, [boxes, embeddings]} = TflInterp.run_pipeline(__MODULE__, 1, [], frame: 0)
+    ```
+  """
+  def run_pipeline(mod, id, inputs \\ [], opts \\ []) do
+    frame = Keyword.get(opts, :frame, 0)
+    count = Enum.count(inputs)
+    data  = for bin <- inputs, into: <<>>, do: <<byte_size(bin)::little-integer-32>> <> bin
+
+    cmd = 29
+    case call(mod, <<cmd::little-integer-32, id::little-integer-32, frame::little-integer-32, count::little-integer-32>> <> data) do
+      {:ok, <<status::little-signed-integer-32>>} when status < 0 -> {:error, status}
+      {:ok, <<_count::little-integer-32, results::binary>>} ->
+        {:ok, for <<size::little-integer-32, tensor::binary-size(size) <- results>> do tensor end}
+      any -> any
+    end
+  end
+
+  @doc """
+  Drop the pipeline.
+
+  ## Parameters
+
+    * mod - modules' names
+    * id  - integer id of the pipeline
+  """
+  def drop_pipeline(mod, id) do
+    cmd = 30
+    case call(mod, <<cmd::little-integer-32, id::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Reset the recurrent state (variable tensors) of the model.
+
+  ## Parameters
+
+    * mod - modules' names
+  """
+  def reset_state(mod) do
+    cmd = 31
+    case call(mod, <<cmd::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Save the recurrent state (variable tensors) of the model as the state of
+  the stream.
+
+  The snapshots are kept in a compact arena in the interpreter, so many
+  streams time-share one stateful model. See `with_state/3`. A model holding
+  the states stays resident under the memory budget.
+
+  The state of the split batch (-b), the buckets (-B) and the selected
+  signature lives outside the primary subgraph, so it is not supported in
+  those modes (status -1).
+
+  ## Parameters
+
+    * mod    - modules' names
+    * stream - integer stream id
+  """
+  def save_state(mod, stream) do
+    cmd = 32
+    case call(mod, <<cmd::little-integer-32, stream::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Restore the recurrent state of the stream to the model.
+
+  The unknown stream starts from the initial state (status 1).
+
+  ## Parameters
+
+    * mod    - modules' names
+    * stream - integer stream id
+  """
+  def restore_state(mod, stream) do
+    cmd = 33
+    case call(mod, <<cmd::little-integer-32, stream::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Drop the recurrent state of the stream.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * stream - integer stream id
+  """
+  def drop_state(mod, stream) do
+    cmd = 34
+    case call(mod, <<cmd::little-integer-32, stream::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Run the function on the recurrent state of the stream.
+
+  The state of the stream is restored before the function, and saved after
+  it. The other processes must not use the model between them.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * stream - integer stream id
+    * fun    - function running the model
+
+  ## Examples.
+
+    ```elixir
+      output_bin =
+        TflInterp.with_state(__MODULE__, stream_id, fn ->
+          __MODULE__
+          |> TflInterp.set_input_tensor(0, chunk)
+          |> TflInterp.invoke()
+          |> TflInterp.get_output_tensor(0)
+        end)
+    ```
+  """
+  def with_state(mod, stream, fun) do
+    restore_state(mod, stream)
+    try do
+      fun.()
+    after
+      save_state(mod, stream)
+    end
+  end
+
+  @doc """
+  Put the audio chunk into the log-mel feature tensor.
+
+  The 16kHz mono PCM chunk is appended to the ring buffer of the audio stream
+  `handle`, and only the new STFT/log-mel frames are computed and written into
+  the input tensor f32 [.., n_mels, frames] in place (Whisper's log-mel
+  spectrogram, e.g. {1,80,3000}). The window slides over the latest `frames`.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * handle - integer handle of the audio stream
+    * index  - index of the input tensor
+    * pcm    - binary of the PCM samples
+    * opts
+      * :format - :f32 (default) or :s16, little endian
+
+  ## Examples.
+
+    ```elixir
+      {:ok, _} = TflInterp.put_audio(Whisper, 0, 0, chunk, format: :s16)
+    ```
+  """
+  def put_audio(mod, handle, index, pcm, opts \\ []) do
+    {format, count} = case Keyword.get(opts, :format, :f32) do
+      :f32 -> {0, div(byte_size(pcm), 4)}
+      :s16 -> {1, div(byte_size(pcm), 2)}
+    end
+
+    cmd = 35
+    case call(mod, <<cmd::little-integer-32, handle::little-integer-32, index::little-integer-32, format::little-integer-32, count::little-integer-32>> <> pcm) do
+      {:ok, result} ->
+        case Jason.decode(result) do
+          {:ok, %{"status" => 0, "frames" => frames, "new" => new}} -> {:ok, %{frames: frames, new: new}}
+          {:ok, %{"status" => status}} -> {:error, status}
+          any -> any
+        end
+      any -> any
+    end
+  end
+
+  @doc """
+  Drop the audio stream.
+
+  ## Parameters
+
+    * mod    - modules' names
+    * handle - integer handle of the audio stream
+  """
+  def drop_audio(mod, handle) do
+    cmd = 36
+    case call(mod, <<cmd::little-integer-32, handle::little-integer-32>>) do
+      {:ok, result} -> Jason.decode(result)
+      any -> any
+    end
+  end
+
+  @doc """
+  Run the function with a deadline on the requests to the interpreter.
+
+  The request whose deadline has passed is skipped in the queue or aborted
+  while running, and returns `{:error, :deadline}`.
+
+  ## Parameters
+
+    * msec - deadline in milliseconds from the arrival of each request
+    * fun - function sending the requests
+
+  ## Examples.
+
+    ```elixir
+      TflInterp.with_deadline(50, fn ->
+        session()
+        |> TflInterp.set_input_tensor(0, input_bin)
+        |> TflInterp.invoke()
+      end)
+    ```
+  """
+  def with_deadline(msec, fun), do: with_request(:tfl_interp_deadline, msec, fun)
+
+  @doc """
+  Run the function with the requests tagged by the stream id.
+
+  When the interpreter runs with the queue policy "latest" (`--queue_policy latest`),
+  a waiting request is dropped by the newer one of the same stream, and
+  returns `{:error, :dropped}`. Use it with the self-contained requests, e.g.
+  `invoke/1` of the session or `run_rois/5`.
+
+  ## Parameters
+
+    * stream - stream id (> 0)
+    * fun - function sending the requests
+
+  ## Examples.
+
+    ```elixir
+      TflInterp.with_stream(camera_id, fn ->
+        session()
+        |> TflInterp.set_input_tensor(0, frame_bin)
+        |> TflInterp.invoke()
+      end)
+    ```
+  """
+  def with_stream(stream, fun), do: with_request(:tfl_interp_stream, stream, fun)
+
+  @doc """
+  Run the function with the requests in the priority class.
+
+  The waiting request of the higher priority class is served first, and
+  the lower one gives way to it when the queue is full. The default is 0.
+
+  ## Parameters
+
+    * priority - priority class (0..65535)
+    * fun - function sending the requests
+  """
+  def with_priority(priority, fun), do: with_request(:tfl_interp_priority, priority, fun)
+
+  @doc """
+  Run the function with the requests on behalf of the tenant.
+
+  The tenants in the same priority class share the interpreter by their
+  weights (`--weights "1:4,2:1"`). The default is 0, weight 1.
+
+  ## Parameters
+
+    * tenant - tenant id (0..65535)
+    * fun - function sending the requests
+
+  ## Examples.
+
+    ```elixir
+      # backfill job
+      TflInterp.with_tenant(2, fn ->
+        Enum.map(samples, &YourModel.predict/1)
+      end)
+    ```
+  """
+  def with_tenant(tenant, fun), do: with_request(:tfl_interp_tenant, tenant, fun)
+
+  @doc """
+  Run the function with the requests addressed to the model.
+
+  The model is loaded by `load_model/4`. The model given at the start is
+  the model id 0, and it is the default.
+
+  ## Parameters
+
+    * id - model id
+    * fun - function sending the requests
+
+  ## Examples.
+
+    ```elixir
+      TflInterp.load_model(__MODULE__, 1, "priv/pose.tflite")
+      TflInterp.with_model(1, fn ->
+        __MODULE__
+        |> TflInterp.set_input_tensor(0, input_bin)
+        |> TflInterp.invoke()
+        |> TflInterp.get_output_tensor(0)
+      end)
+    ```
+  """
+  def with_model(id, fun), do: with_request(:tfl_interp_model, id, fun)
+
+  defp with_request(key, value, fun) do
+    prev = Process.put(key, value)
+    try do
+      fun.()
+    after
+      if prev, do: Process.put(key, prev), else: Process.delete(key)
+    end
+  end
+
+  @doc """
+  Cancel all requests to the interpreter: the waiting ones and the running one.
+
+  The cancelled request returns `{:error, :cancelled}`.
+
+  ## Parameters
+
+    * mod - modules' names
+  """
+  def cancel(mod) do
+    GenServer.cast(mod, {:cancel, 0xFFFFFFFF})
+  end
+
+  defp call(mod, cmd_line) do
+    GenServer.call(mod, {:cmd, cmd_line,
+      Process.get(:tfl_interp_deadline, 0),
+      Process.get(:tfl_interp_stream, 0),
+      Process.get(:tfl_interp_priority, 0),
+      Process.get(:tfl_interp_tenant, 0),
+      Process.get(:tfl_interp_model, 0)}, @timeout)
+  end
 
   def get_memo(mod) do
     case GenServer.call(mod, :memo, @timeout) do
@@ -1,12 +1,17 @@
 defmodule TflInterp.PreCompiled do
   alias TflInterp.URL
 
-  @url %{
+  # release of the precompiled binaries speaking the port protocol of this version.
+  # the binaries up to 0.1.16 speak the old protocol (no request envelope), and none
+  # are published for 0.2.0 yet, so the precompiled binaries are disabled.
+  @release nil
+
+  @url (if @release, do: %{
     "tflite-cpu-windows-x86_64" =>
-      {"tfl_interp.exe", "https://github.com/shoz-f/tfl_interp/releases/download/0.1.16/tfl_interp-cpu-windows-x86_64.zip"},
+      {"tfl_interp.exe", "https://github.com/shoz-f/tfl_interp/releases/download/#{@release}/tfl_interp-cpu-windows-x86_64.zip"},
     "tflite-cpu-linux-x86_64" =>
-      {"tfl_interp", "https://github.com/shoz-f/tfl_interp/releases/download/0.1.16/tfl_interp-cpu-linux-x86_64.zip"},
-  }
+      {"tfl_interp", "https://github.com/shoz-f/tfl_interp/releases/download/#{@release}/tfl_interp-cpu-linux-x86_64.zip"},
+  }, else: %{})
 
   @os_default (case :os.type() do
     {:win32, :nt}   -> %{name: {"windows", "x86_64"}, ext: ".exe"}
@@ -16,7 +21,7 @@ defmodule TflInterp.PreCompiled do
 
 
   def using_precompiled?(),
-    do: System.get_env("NNCOMPILED", "NO") |> String.upcase() |> Kernel.in(["YES", "OK", "TRUE"])
+    do: @url != %{} && (System.get_env("NNCOMPILED", "NO") |> String.upcase() |> Kernel.in(["YES", "OK", "TRUE"]))
 
   def download(name, force \\ false) do
     # complement target name.
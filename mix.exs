@@ -4,7 +4,7 @@ defmodule TflInterp.MixProject do
   def project do
     [
       app: :tfl_interp,
-      version: "0.1.16",
+      version: "0.2.0",
       elixir: "~> 1.14",
       start_permanent: Mix.env() == :prod,
       description: description(),
@@ -20,8 +20,12 @@ defmodule TflInterp.MixProject do
     ++ unless using_precompiled?(), do: cmake_conf(), else: []
   end
 
+  # no precompiled binaries speak the port protocol of 0.2.0 yet (see TflInterp.PreCompiled),
+  # so NNCOMPILED is ignored and tfl_interp is built from the source.
+  @precompiled_available false
+
   def using_precompiled?(),
-    do: System.get_env("NNCOMPILED", "NO") |> String.upcase() |> Kernel.in(["YES", "OK", "TRUE"])
+    do: @precompiled_available && (System.get_env("NNCOMPILED", "NO") |> String.upcase() |> Kernel.in(["YES", "OK", "TRUE"]))
 
   # Run "mix help compile.app" to learn about applications.
   def application do
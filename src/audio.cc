@@ -0,0 +1,432 @@
+/***  File Header  ************************************************************/
+/**
+* audio.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: streaming audio front end
+* @author      Shozo Fukuda
+* @date create Fri Oct 24 10:17:36 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "preprocess.h"
+
+#include <map>
+#include <memory>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+
+typedef std::complex<float> Complex;
+
+static const double PI = 3.14159265358979323846;
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* mixed radix FFT
+* @par DESCRIPTION
+*   decimation in time over the prime factors of n (n_fft 400 = 4*4*5*5 is
+*   not a power of 2). the twiddles are made once.
+**/
+/**************************************************************************{{{*/
+class Fft {
+//LIFECYCLE:
+public:
+    Fft(int n) : mN(n), mTwiddle(n) {
+        for (int k = 0; k < n; k++) {
+            mTwiddle[k] = std::polar(1.0f, static_cast<float>(-2.0*PI*k/n));
+        }
+        // factors: {p, m} .. with n = p*m at every stage, radix 4 first
+        int p = 4;
+        while (n > 1) {
+            while (n % p != 0) {
+                p = (p == 4) ? 2 : (p == 2) ? 3 : p + 2;
+                if (p*p > n) { p = n; }
+            }
+            n /= p;
+            mFactor.push_back(p);
+            mFactor.push_back(n);
+        }
+    }
+
+//ACTION:
+public:
+    void forward(const Complex* in, Complex* out) {
+        work(out, in, 1, 0);
+    }
+
+private:
+    void work(Complex* out, const Complex* in, size_t stride, size_t stage) {
+        const int p = mFactor[stage];
+        const int m = mFactor[stage + 1];
+
+        if (m == 1) {
+            for (int i = 0; i < p; i++) {
+                out[i] = in[i*stride];
+            }
+        }
+        else {
+            for (int i = 0; i < p; i++) {
+                work(out + i*m, in + i*stride, stride*p, stage + 2);
+            }
+        }
+
+        // butterflies of radix p
+        Complex scratch[16];
+        std::vector<Complex> heap;
+        Complex* buf = scratch;
+        if (p > 16) {
+            heap.resize(p);
+            buf = heap.data();
+        }
+        for (int u = 0; u < m; u++) {
+            for (int q = 0, k = u; q < p; q++, k += m) {
+                buf[q] = out[k];
+            }
+            for (int q = 0, k = u; q < p; q++, k += m) {
+                Complex acc = buf[0];
+                size_t  tw  = 0;
+                for (int r = 1; r < p; r++) {
+                    tw += stride*k;
+                    tw %= mN;
+                    acc += buf[r]*mTwiddle[tw];
+                }
+                out[k] = acc;
+            }
+        }
+    }
+
+//ATTRIBUTE:
+private:
+    int                  mN;
+    std::vector<Complex> mTwiddle;
+    std::vector<int>     mFactor;
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* streaming log-mel spectrogram
+* @par DESCRIPTION
+*   the PCM chunks go into the ring buffer, and only the STFT frames newly
+*   covered by the audio are computed (hann window, reflect padding at the
+*   start, slaney mel filters, log10) as Whisper does. the last "frames"
+*   log-mel frames make the window of the feature tensor [.., n_mels, frames].
+**/
+/**************************************************************************{{{*/
+class AudioStream {
+//CONSTANT:
+public:
+    enum {
+        SAMPLE_RATE = 16000,
+        N_FFT       = 400,
+        HOP         = 160,
+    };
+
+//LIFECYCLE:
+public:
+    AudioStream(int n_mels, int frames) : mMels(n_mels), mFrames(frames), mFft(N_FFT) {
+        // periodic hann window
+        mWindow.resize(N_FFT);
+        for (int i = 0; i < N_FFT; i++) {
+            mWindow[i] = static_cast<float>(0.5 - 0.5*cos(2.0*PI*i/N_FFT));
+        }
+
+        // slaney mel filters as the sparse rows over the FFT bins
+        auto hz_to_mel = [](double f) {
+            return (f < 1000.0) ? f/(200.0/3) : 15.0 + log(f/1000.0)/(log(6.4)/27.0);
+        };
+        auto mel_to_hz = [](double m) {
+            return (m < 15.0) ? m*(200.0/3) : 1000.0*exp((m - 15.0)*(log(6.4)/27.0));
+        };
+        const int bins = N_FFT/2 + 1;
+        const double top = hz_to_mel(SAMPLE_RATE/2.0);
+        std::vector<double> hz(n_mels + 2);
+        for (int i = 0; i < n_mels + 2; i++) {
+            hz[i] = mel_to_hz(top*i/(n_mels + 1));
+        }
+
+        mFilterStart.resize(n_mels);
+        mFilter.resize(n_mels);
+        for (int m = 0; m < n_mels; m++) {
+            const double enorm = 2.0/(hz[m + 2] - hz[m]);
+            mFilterStart[m] = bins;
+            for (int k = 0; k < bins; k++) {
+                double f = static_cast<double>(k)*SAMPLE_RATE/N_FFT;
+                double w = std::max(0.0, std::min((f - hz[m])/(hz[m + 1] - hz[m]), (hz[m + 2] - f)/(hz[m + 2] - hz[m + 1])));
+                if (w > 0.0) {
+                    mFilterStart[m] = std::min(mFilterStart[m], k);
+                    mFilter[m].resize(k - mFilterStart[m] + 1, 0.0f);
+                    mFilter[m].back() = static_cast<float>(w*enorm);
+                }
+            }
+        }
+
+        mRing.resize(4096);
+        mLogMel.resize(static_cast<size_t>(frames)*n_mels);
+        mFrameMax.resize(frames);
+    }
+
+//ACTION:
+public:
+    // append the samples, and compute the new frames. return the number of new frames
+    int push(const float* pcm, size_t count) {
+        // keep the samples from the window of the next frame
+        const int64_t keep = std::max<int64_t>(0, mNext*HOP - N_FFT/2);
+        const size_t need = static_cast<size_t>(mCount - keep) + count;
+        if (need > mRing.size()) {
+            size_t capacity = mRing.size();
+            while (capacity < need) { capacity *= 2; }
+            std::vector<float> ring(capacity);
+            for (int64_t i = keep; i < mCount; i++) {
+                ring[i & (capacity - 1)] = mRing[i & (mRing.size() - 1)];
+            }
+            mRing.swap(ring);
+        }
+
+        const size_t mask = mRing.size() - 1;
+        for (size_t i = 0; i < count; i++) {
+            if (mHead.size() <= N_FFT/2) {
+                mHead.push_back(pcm[i]);
+            }
+            mRing[(mCount + i) & mask] = pcm[i];
+        }
+        mCount += count;
+
+        // the frame "t" is centered at t*HOP
+        int n = 0;
+        while (mCount > N_FFT/2 && mCount >= mNext*HOP + N_FFT/2) {
+            compute_frame();
+            n++;
+        }
+        return n;
+    }
+
+    // put the window into the feature tensor
+    // only the new columns are written while the clamp floor and the window
+    // stay, and "intact" (the tensor holds the last write of this stream)
+    void write(TensorView& tensor, bool intact) {
+        float* data = reinterpret_cast<float*>(tensor.mData);
+
+        const int64_t n     = std::min<int64_t>(mNext, mFrames);
+        const int64_t first = mNext - n;
+
+        float peak = -10.0f;    // log10 of the silence (padding)
+        for (int64_t t = first; t < mNext; t++) {
+            peak = std::max(peak, mFrameMax[t % mFrames]);
+        }
+        const float floor = peak - 8.0f;
+
+        int64_t from = mWritten - first;
+        if (!intact || floor != mFloor || first != mFirst) {
+            from = 0;
+        }
+
+        const float pad = (std::max(-10.0f, floor) + 4.0f)/4.0f;
+        for (int m = 0; m < mMels; m++) {
+            float* row = data + static_cast<size_t>(m)*mFrames;
+            for (int64_t c = from; c < n; c++) {
+                float v = mLogMel[((first + c) % mFrames)*mMels + m];
+                row[c] = (std::max(v, floor) + 4.0f)/4.0f;
+            }
+            if (from == 0) {
+                std::fill(row + n, row + mFrames, pad);
+            }
+        }
+
+        mFloor   = floor;
+        mFirst   = first;
+        mWritten = mNext;
+    }
+
+//INQUIRY:
+public:
+    int     mels()   const { return mMels;   }
+    int     frames() const { return mFrames; }
+    int64_t count()  const { return mNext;   }  // frames computed so far
+
+private:
+    // the sample at "i", reflected at the start
+    float sample(int64_t i) const {
+        return (i < 0) ? mHead[-i] : mRing[i & (mRing.size() - 1)];
+    }
+
+    void compute_frame() {
+        const int64_t begin = mNext*HOP - N_FFT/2;
+        for (int i = 0; i < N_FFT; i++) {
+            mIn[i] = Complex(mWindow[i]*sample(begin + i), 0.0f);
+        }
+        mFft.forward(mIn, mOut);
+
+        float power[N_FFT/2 + 1];
+        for (int k = 0; k <= N_FFT/2; k++) {
+            power[k] = std::norm(mOut[k]);
+        }
+
+        float* logmel = &mLogMel[(mNext % mFrames)*mMels];
+        float  peak   = -10.0f;
+        for (int m = 0; m < mMels; m++) {
+            const float* w = mFilter[m].data();
+            const float* p = power + mFilterStart[m];
+            float acc = 0.0f;
+            for (size_t k = 0; k < mFilter[m].size(); k++) {
+                acc += w[k]*p[k];
+            }
+            logmel[m] = log10f(std::max(acc, 1e-10f));
+            peak = std::max(peak, logmel[m]);
+        }
+        mFrameMax[mNext % mFrames] = peak;
+        mNext++;
+    }
+
+//ATTRIBUTE:
+private:
+    int                 mMels;
+    int                 mFrames;
+
+    // STFT
+    Fft                 mFft;
+    std::vector<float>  mWindow;
+    std::vector<int>    mFilterStart;   // the first FFT bin of the filter
+    std::vector<std::vector<float>> mFilter;
+    Complex             mIn[N_FFT];
+    Complex             mOut[N_FFT];
+
+    // ring buffer of PCM: the sample i is at [i & (size - 1)]
+    std::vector<float>  mRing;
+    int64_t             mCount { 0 };   // samples received
+    std::vector<float>  mHead;          // the first N_FFT/2 + 1 samples to reflect
+
+    // log-mel frames of the window: the frame t is at [t % frames]
+    std::vector<float>  mLogMel;
+    std::vector<float>  mFrameMax;
+    int64_t             mNext { 0 };    // the next frame to compute
+
+    // written to the tensor
+    float               mFloor { 0.0f };
+    int64_t             mFirst { -1 };
+    int64_t             mWritten { 0 };
+};
+
+static std::map<unsigned int, std::unique_ptr<AudioStream>> gAudio;
+
+// the last stream written into the tensor (data address), and the count of
+// the writes into the input after it. any other write makes it stale
+struct AudioWriter {
+    const TinyMLInterp* mInterp;
+    const AudioStream*  mStream;
+    uint64_t            mWrites;
+};
+static std::map<const void*, AudioWriter> gWriter;
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* put the audio chunk into the log-mel feature tensor
+* @par DESCRIPTION
+*   the 16kHz mono PCM chunk is appended to the audio stream "handle", and
+*   the input tensor f32 [.., n_mels, frames] (e.g. Whisper {1,80,3000}) is
+*   updated in place with the new frames. the window slides over the latest
+*   "frames" frames.
+*
+* @retval json  {"status": 0, "frames": n, "new": n}
+**/
+/**************************************************************************{{{*/
+std::string
+put_audio(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int handle;
+        unsigned int index;         // input tensor
+        unsigned int format;        // 0: f32, 1: s16
+        unsigned int count;         // samples
+        uint8_t      data[1];
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    const uint64_t writes = sys.mInterp->input_writes(prms->index);
+
+    TensorView tensor;
+    if (prms->index >= sys.mInterp->InputCount()
+    || !sys.mInterp->get_input_view(prms->index, tensor)
+    ||  tensor.mDType != TensorSpec::DTYPE_F32
+    ||  tensor.mShape.size() < 2) {
+        res["status"] = -1;
+        return res.dump();
+    }
+    const int n_mels = tensor.mShape[tensor.mShape.size() - 2];
+    const int frames = tensor.mShape[tensor.mShape.size() - 1];
+
+    sys.start_watch();
+
+    std::unique_ptr<AudioStream>& stream = gAudio[prms->handle];
+    if (!stream || stream->mels() != n_mels || stream->frames() != frames) {
+        stream.reset(new AudioStream(n_mels, frames));
+    }
+
+    std::vector<float> pcm;
+    const float* samples = reinterpret_cast<const float*>(prms->data);
+    if (prms->format == 1) {
+        const int16_t* s16 = reinterpret_cast<const int16_t*>(prms->data);
+        pcm.resize(prms->count);
+        for (unsigned int i = 0; i < prms->count; i++) {
+            pcm[i] = s16[i]/32768.0f;
+        }
+        samples = pcm.data();
+    }
+
+    int n = stream->push(samples, prms->count);
+
+    auto it = gWriter.find(tensor.mData);
+    bool intact = (it != gWriter.end())
+               && it->second.mInterp == sys.mInterp
+               && it->second.mStream == stream.get()
+               && it->second.mWrites == writes;
+    stream->write(tensor, intact);
+    gWriter[tensor.mData] = { sys.mInterp, stream.get(), sys.mInterp->input_writes(prms->index) };
+
+    sys.LAP_INPUT();
+
+    res["status"] = 0;
+    res["frames"] = std::min<int64_t>(stream->count(), frames);
+    res["new"]    = n;
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* drop the audio stream
+* @par DESCRIPTION
+*
+*
+* @retval json  {"status": 0}
+**/
+/**************************************************************************{{{*/
+std::string
+drop_audio(SysInfo&, const void* args)
+{
+    struct Prms {
+        unsigned int handle;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    auto it = gAudio.find(prms->handle);
+    if (it == gAudio.end()) {
+        res["status"] = -1;
+        return res.dump();
+    }
+
+    for (auto w = gWriter.begin(); w != gWriter.end(); ) {
+        w = (w->second.mStream == it->second.get()) ? gWriter.erase(w) : std::next(w);
+    }
+    gAudio.erase(it);
+
+    res["status"] = 0;
+    return res.dump();
+}
+
+/*** audio.cc *************************************************************}}}*/
@@ -0,0 +1,223 @@
+/***  File Header  ************************************************************/
+/**
+* framecache.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: pre processing
+* @author      Shozo Fukuda
+* @date create Mon Oct 20 08:14:09 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "preprocess.h"
+
+#include <map>
+#include <cstddef>
+
+/***  Type ****************************************************************}}}*/
+/**
+* cached image frame
+**/
+/**************************************************************************{{{*/
+struct CachedFrame {
+    std::vector<uint8_t> mPixels;
+    ImageFrame           mFrame;
+};
+
+static std::map<unsigned int, CachedFrame> gFrameCache;
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* find the cached image frame
+* @par DESCRIPTION
+*
+*
+* @retval pointer to the frame, nullptr if not cached
+**/
+/**************************************************************************{{{*/
+const ImageFrame*
+find_frame(unsigned int handle)
+{
+    auto it = gFrameCache.find(handle);
+    return (it != gFrameCache.end()) ? &it->second.mFrame : nullptr;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* put the image frame to the cache
+* @par DESCRIPTION
+*   the frame is raw HWC u8 or JPEG/PNG, and it is kept under the handle
+*   until drop_frame or the next put_frame with the same handle.
+*
+* @retval json  {"status": 0, "frame": [width, height, channel]}
+**/
+/**************************************************************************{{{*/
+std::string
+put_frame(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int handle;
+        unsigned int encoded;       // 0: raw HWC u8, 1: JPEG/PNG
+        unsigned int width;         // shape of the raw frame
+        unsigned int height;
+        unsigned int channel;
+        unsigned int size;
+        uint8_t      data[1];
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    sys.start_watch();
+
+    CachedFrame entry;
+    if (prms->encoded) {
+        if (!decode_image(prms->data, prms->size, entry.mPixels, entry.mFrame)) {
+            res["status"] = -4;
+            return res.dump();
+        }
+    }
+    else {
+        if (static_cast<size_t>(prms->width)*prms->height*prms->channel != prms->size) {
+            res["status"] = -2;
+            return res.dump();
+        }
+        entry.mPixels.assign(prms->data, prms->data + prms->size);
+        entry.mFrame = {
+            static_cast<int>(prms->width), static_cast<int>(prms->height), static_cast<int>(prms->channel), nullptr
+        };
+    }
+
+    CachedFrame& cache = gFrameCache[prms->handle];
+    cache.mPixels.swap(entry.mPixels);
+    cache.mFrame = entry.mFrame;
+    cache.mFrame.mData = cache.mPixels.data();
+
+    res["status"] = 0;
+    res["frame"]  = { cache.mFrame.mWidth, cache.mFrame.mHeight, cache.mFrame.mChannel };
+
+    sys.LAP_INPUT();
+
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* drop the image frame from the cache
+* @par DESCRIPTION
+*
+*
+* @retval json  {"status": 0}
+**/
+/**************************************************************************{{{*/
+std::string
+drop_frame(SysInfo&, const void* args)
+{
+    struct Prms {
+        unsigned int handle;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    res["status"] = (gFrameCache.erase(prms->handle) > 0) ? 0 : -1;
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* run inference on the ROIs of the cached frame
+* @par DESCRIPTION
+*   crop every box from the cached frame, resize it to the input shape and
+*   run. if the input tensor has the batch dimension N, the boxes are packed
+*   into the batch N at a time.
+*
+* @retval binary  <<num_box::32, {rx::f32, ry::f32, count::32, {size::32, bin}..}..>>
+* @retval binary  <<error_code::32>> - error {-1..-3, -11..-13}
+**/
+/**************************************************************************{{{*/
+std::string
+run_rois(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int handle;
+        unsigned int index;         // input tensor
+        ImageOpts    opts;
+        unsigned int num_box;
+        float        boxes[1];      // {x1, y1, x2, y2} normalized to the frame
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    auto error = [](int status) {
+        return std::string(reinterpret_cast<char*>(&status), sizeof(status));
+    };
+
+    auto it = gFrameCache.find(prms->handle);
+    TensorView tensor;
+    if (it == gFrameCache.end()
+    ||  prms->index >= sys.mInterp->InputCount()
+    || !sys.mInterp->get_input_view(prms->index, tensor)) {
+        return error(-1);
+    }
+    const ImageFrame& frame = it->second.mFrame;
+
+    const size_t batch = (tensor.mShape.size() == 4) ? tensor.mShape[0] : 1;
+    const uint32_t count = static_cast<uint32_t>(sys.mInterp->OutputCount());
+
+    uint32_t num_box = prms->num_box;
+    std::string output(reinterpret_cast<char*>(&num_box), sizeof(num_box));
+
+    sys.start_watch();
+
+    ImageOpts opts = prms->opts;
+    for (uint32_t base = 0; base < num_box; base += static_cast<uint32_t>(batch)) {
+        const size_t n = std::min<size_t>(batch, num_box - base);
+
+        // crop & resize the boxes into the batch
+        std::vector<float> aspect(2*n);
+        for (size_t b = 0; b < n; b++) {
+            // the boxes in the packed args may be unaligned
+            float box[4];
+            memcpy(box, reinterpret_cast<const uint8_t*>(prms) + offsetof(Prms, boxes) + 4*(base + b)*sizeof(float), sizeof(box));
+            box_to_roi(box, frame, opts);
+
+            int status = image_to_tensor(frame, opts, tensor, b, &aspect[2*b]);
+            if (status < 0) {
+                return error(status);
+            }
+        }
+
+        sys.LAP_INPUT();
+
+        int status = sys.mInterp->invoke();
+        if (status < 0) {
+            return error(status);
+        }
+
+        sys.LAP_EXEC();
+
+        // split the outputs along the batch
+        std::vector<std::string> otensors;
+        for (uint32_t index = 0; index < count; index++) {
+            otensors.push_back(sys.mInterp->get_output_tensor(index));
+        }
+        for (size_t b = 0; b < n; b++) {
+            output += std::string(reinterpret_cast<char*>(&aspect[2*b]), 2*sizeof(float));
+            output += std::string(reinterpret_cast<const char*>(&count), sizeof(count));
+            for (const auto& otensor : otensors) {
+                uint32_t size = static_cast<uint32_t>(otensor.size()/batch);
+                output += std::string(reinterpret_cast<char*>(&size), sizeof(size))
+                       +  otensor.substr(b*size, size);
+            }
+        }
+
+        sys.LAP_OUTPUT();
+    }
+
+    return output;
+}
+
+/*** framecache.cc ********************************************************}}}*/
@@ -0,0 +1,105 @@
+/***  File Header  ************************************************************/
+/**
+* imgdec.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: pre processing
+* @author      Shozo Fukuda
+* @date create Sun Oct 19 19:30:52 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "preprocess.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_PNG
+#define STBI_NO_STDIO
+#include "stb_image.h"
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* decode the compressed image
+* @par DESCRIPTION
+*   decode JPEG/PNG into the raw HWC u8 pixels.
+*
+* @retval true  success
+* @retval false unsupported or broken image
+**/
+/**************************************************************************{{{*/
+bool
+decode_image(const uint8_t* data, size_t size, std::vector<uint8_t>& pixels, ImageFrame& frame)
+{
+    int width, height, channel;
+    stbi_uc* img = stbi_load_from_memory(data, static_cast<int>(size), &width, &height, &channel, 0);
+    if (img == nullptr) {
+        return false;
+    }
+
+    pixels.assign(img, img + static_cast<size_t>(width)*height*channel);
+    stbi_image_free(img);
+
+    frame.mWidth   = width;
+    frame.mHeight  = height;
+    frame.mChannel = channel;
+    frame.mData    = pixels.data();
+
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* set the compressed image to the input tensor
+* @par DESCRIPTION
+*   decode JPEG/PNG and put it into the input tensor through the same path
+*   as set_input_image.
+*
+* @retval json  {"status": 0, "aspect": [rx, ry], "frame": [width, height, channel]}
+**/
+/**************************************************************************{{{*/
+std::string
+set_input_encoded_image(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int index;
+        ImageOpts    opts;
+        unsigned int size;
+        uint8_t      data[1];
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    TensorView tensor;
+    if (prms->index >= sys.mInterp->InputCount()
+    || !sys.mInterp->get_input_view(prms->index, tensor)) {
+        res["status"] = -1;
+        return res.dump();
+    }
+
+    sys.start_watch();
+
+    std::vector<uint8_t> pixels;
+    ImageFrame frame;
+    if (!decode_image(prms->data, prms->size, pixels, frame)) {
+        res["status"] = -4;
+        return res.dump();
+    }
+
+    float aspect[2];
+    int status = image_to_tensor(frame, prms->opts, tensor, 0, aspect);
+
+    res["status"] = status;
+    if (status == 0) {
+        res["aspect"] = { aspect[0], aspect[1] };
+        res["frame"]  = { frame.mWidth, frame.mHeight, frame.mChannel };
+    }
+
+    sys.LAP_INPUT();
+
+    return res.dump();
+}
+
+/*** imgdec.cc ************************************************************}}}*/
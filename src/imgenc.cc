@@ -0,0 +1,266 @@
+/***  File Header  ************************************************************/
+/**
+* imgenc.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: post processing
+* @author      Shozo Fukuda
+* @date create Sun Oct 19 14:02:36 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "postprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/***  Type ****************************************************************}}}*/
+/**
+* image encoder options
+**/
+/**************************************************************************{{{*/
+enum ImgNorm {
+    IMGNORM_RANGE = 0,      // fixed range [lo, hi] -> [0, max]
+    IMGNORM_MINMAX,         // per-frame [min, max] -> [0, max]
+};
+
+enum ImgEncoding {
+    IMGENC_RAW = 0,         // HWC pixels
+    IMGENC_QOI,             // QOI - "Quite OK Image Format" (u8 only)
+};
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* QOI encoder
+* @par DESCRIPTION
+*   lossless image encoding; see https://qoiformat.org/qoi-specification.pdf
+*   gray scale image is expanded to RGB.
+**/
+/**************************************************************************{{{*/
+static std::string
+encode_qoi(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels)
+{
+    enum {
+        QOI_OP_INDEX = 0x00,
+        QOI_OP_DIFF  = 0x40,
+        QOI_OP_LUMA  = 0x80,
+        QOI_OP_RUN   = 0xc0,
+        QOI_OP_RGB   = 0xfe,
+        QOI_OP_RGBA  = 0xff,
+    };
+    struct Rgba { uint8_t r, g, b, a; };
+    auto hash = [](const Rgba& p) { return (p.r*3 + p.g*5 + p.b*7 + p.a*11) % 64; };
+    auto put32 = [](std::string& s, uint32_t v) {
+        s.push_back(static_cast<char>(v >> 24)); s.push_back(static_cast<char>(v >> 16));
+        s.push_back(static_cast<char>(v >>  8)); s.push_back(static_cast<char>(v));
+    };
+
+    const uint8_t qoi_channels = (channels == 4) ? 4 : 3;
+
+    std::string res("qoif");
+    res.reserve(14 + static_cast<size_t>(width)*height*(qoi_channels + 1) + 8);
+    put32(res, width);
+    put32(res, height);
+    res.push_back(static_cast<char>(qoi_channels));
+    res.push_back(0);   // sRGB with linear alpha
+
+    Rgba index[64] = {};
+    Rgba prev = { 0, 0, 0, 255 };
+    int  run  = 0;
+
+    const size_t n = static_cast<size_t>(width)*height;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t* p = pixels + i*channels;
+        Rgba px;
+        switch (channels) {
+        case 1:  px = { p[0], p[0], p[0], 255 };  break;
+        case 4:  px = { p[0], p[1], p[2], p[3] }; break;
+        default: px = { p[0], p[1], p[2], 255 };  break;
+        }
+
+        if (memcmp(&px, &prev, sizeof(Rgba)) == 0) {
+            if (++run == 62 || i == n-1) {
+                res.push_back(static_cast<char>(QOI_OP_RUN | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0) {
+            res.push_back(static_cast<char>(QOI_OP_RUN | (run - 1)));
+            run = 0;
+        }
+
+        int pos = hash(px);
+        if (memcmp(&index[pos], &px, sizeof(Rgba)) == 0) {
+            res.push_back(static_cast<char>(QOI_OP_INDEX | pos));
+        }
+        else {
+            index[pos] = px;
+
+            if (px.a == prev.a) {
+                int8_t vr = static_cast<int8_t>(px.r - prev.r);
+                int8_t vg = static_cast<int8_t>(px.g - prev.g);
+                int8_t vb = static_cast<int8_t>(px.b - prev.b);
+                int8_t vg_r = static_cast<int8_t>(vr - vg);
+                int8_t vg_b = static_cast<int8_t>(vb - vg);
+
+                if (-2 <= vr && vr <= 1 && -2 <= vg && vg <= 1 && -2 <= vb && vb <= 1) {
+                    res.push_back(static_cast<char>(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+                }
+                else if (-8 <= vg_r && vg_r <= 7 && -32 <= vg && vg <= 31 && -8 <= vg_b && vg_b <= 7) {
+                    res.push_back(static_cast<char>(QOI_OP_LUMA | (vg + 32)));
+                    res.push_back(static_cast<char>((vg_r + 8) << 4 | (vg_b + 8)));
+                }
+                else {
+                    res.push_back(static_cast<char>(QOI_OP_RGB));
+                    res.push_back(static_cast<char>(px.r));
+                    res.push_back(static_cast<char>(px.g));
+                    res.push_back(static_cast<char>(px.b));
+                }
+            }
+            else {
+                res.push_back(static_cast<char>(QOI_OP_RGBA));
+                res.push_back(static_cast<char>(px.r));
+                res.push_back(static_cast<char>(px.g));
+                res.push_back(static_cast<char>(px.b));
+                res.push_back(static_cast<char>(px.a));
+            }
+        }
+        prev = px;
+    }
+
+    // end marker
+    res.append(7, '\0');
+    res.push_back(1);
+
+    return res;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* normalize and convert the pixels
+* @par DESCRIPTION
+*   dst = clamp((src - lo)*scale, 0, max). NCHW is transposed to HWC.
+**/
+/**************************************************************************{{{*/
+template <class T>
+static std::string
+convert_pixels(const std::vector<float>& src, size_t H, size_t W, size_t C, bool nchw, float lo, float hi)
+{
+    const float vmax  = static_cast<float>(std::numeric_limits<T>::max());
+    const float scale = (hi > lo) ? vmax/(hi - lo) : 0.0f;
+    const size_t HW = H*W;
+
+    std::string res(HW*C*sizeof(T), '\0');
+    T* dst = reinterpret_cast<T*>(&res[0]);
+
+    auto conv = [=](float x) {
+        float v = (x - lo)*scale + 0.5f;
+        return static_cast<T>(std::min(std::max(v, 0.0f), vmax));
+    };
+
+    if (nchw && C > 1) {
+        for (size_t c = 0; c < C; c++) {
+            const float* plane = src.data() + c*HW;
+            T* d = dst + c;
+            for (size_t i = 0; i < HW; i++, d += C) { *d = conv(plane[i]); }
+        }
+    }
+    else {
+        const float* s = src.data();
+        for (size_t i = 0, n = HW*C; i < n; i++) { dst[i] = conv(s[i]); }
+    }
+
+    return res;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* float-to-image output encoder
+* @par DESCRIPTION
+*   normalize the float output tensor to u8/u16 HWC image, and encode it.
+*
+* @retval binary  <<height::32, width::32, channel::32, payload::binary>>
+* @retval empty   error
+**/
+/**************************************************************************{{{*/
+std::string
+encode_image(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int index;
+        unsigned int nchw;          // layout: 0 = [1, H, W, C], 1 = [1, C, H, W]
+        unsigned int norm;          // ImgNorm
+        float        lo;            // range of IMGNORM_RANGE
+        float        hi;
+        unsigned int dtype;         // TensorSpec::DTYPE_U8 or DTYPE_U16
+        unsigned int encoding;      // ImgEncoding
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    TensorView view;
+    if (prms->index >= sys.mInterp->OutputCount()
+    || !sys.mInterp->get_output_view(prms->index, view)) {
+        return std::string("");
+    }
+
+    // decompose the shape into {H, W, C}
+    std::vector<int> shape(view.mShape);
+    while (shape.size() > 2 && shape.front() == 1) { shape.erase(shape.begin()); }
+    if (shape.size() == 2) {
+        shape.insert(prms->nchw ? shape.begin() : shape.end(), 1);
+    }
+    if (shape.size() != 3) {
+        return std::string("");
+    }
+    const size_t H = prms->nchw ? shape[1] : shape[0];
+    const size_t W = prms->nchw ? shape[2] : shape[1];
+    const size_t C = prms->nchw ? shape[0] : shape[2];
+
+    // QOI holds only u8 gray/RGB/RGBA
+    if (prms->encoding == IMGENC_QOI
+    && (prms->dtype != TensorSpec::DTYPE_U8 || (C != 1 && C != 3 && C != 4))) {
+        return std::string("");
+    }
+
+    sys.start_watch();
+
+    std::vector<float>&& src = view.to_float();
+
+    float lo = prms->lo, hi = prms->hi;
+    if (prms->norm == IMGNORM_MINMAX) {
+        auto minmax = std::minmax_element(src.begin(), src.end());
+        lo = *minmax.first;
+        hi = *minmax.second;
+    }
+
+    std::string pixels;
+    switch (prms->dtype) {
+    case TensorSpec::DTYPE_U8:  pixels = convert_pixels<uint8_t>(src, H, W, C, prms->nchw, lo, hi);  break;
+    case TensorSpec::DTYPE_U16: pixels = convert_pixels<uint16_t>(src, H, W, C, prms->nchw, lo, hi); break;
+    default:
+        return std::string("");
+    }
+
+    uint32_t header[3] = { static_cast<uint32_t>(H), static_cast<uint32_t>(W), static_cast<uint32_t>(C) };
+    std::string res(reinterpret_cast<char*>(header), sizeof(header));
+
+    if (prms->encoding == IMGENC_QOI) {
+        res += encode_qoi(reinterpret_cast<const uint8_t*>(pixels.data()),
+                          static_cast<uint32_t>(W), static_cast<uint32_t>(H), static_cast<uint32_t>(C));
+    }
+    else {
+        res += pixels;
+    }
+
+    sys.LAP_OUTPUT();
+
+    return res;
+}
+
+/*** imgenc.cc ************************************************************}}}*/
@@ -0,0 +1,220 @@
+/***  File Header  ************************************************************/
+/**
+* keypoints.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: post processing
+* @author      Shozo Fukuda
+* @date create Sat Oct 18 16:40:05 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "postprocess.h"
+
+#include <algorithm>
+#include <cmath>
+
+/***  Type ****************************************************************}}}*/
+/**
+* layout of the keypoint tensor
+**/
+/**************************************************************************{{{*/
+enum KeypointMode {
+    KEYPOINT_YXS = 0,       // [.., K, 3] - {y, x, score} ex. MoveNet
+    KEYPOINT_XYS,           // [.., K, 3] - {x, y, score}
+    HEATMAP_NHWC,           // [1, H, W, K]
+    HEATMAP_NCHW,           // [1, K, H, W]
+};
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* rescale the normalized position to the letterboxed image
+* @par DESCRIPTION
+*   same as TflInterp.adjust2letterbox/2.
+**/
+/**************************************************************************{{{*/
+static json
+joint(float x, float y, float score, float rx, float ry)
+{
+    x = std::min(std::max(x, 0.0f), 1.0f);
+    y = std::min(std::max(y, 0.0f), 1.0f);
+
+    auto res = json::array();
+    res.push_back(x/rx);
+    res.push_back(y/ry);
+    res.push_back(score);
+    return res;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* sub-pixel refinement
+* @par DESCRIPTION
+*   fit a parabola to the peak and its neighbours, return the shift in [-0.5, 0.5].
+**/
+/**************************************************************************{{{*/
+static float
+refine(float left, float center, float right)
+{
+    float denom = left - 2.0f*center + right;
+    if (denom >= 0.0f) {
+        return 0.0f;
+    }
+    float shift = 0.5f*(left - right)/denom;
+    return std::min(std::max(shift, -0.5f), 0.5f);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* decode keypoints
+* @par DESCRIPTION
+*   decode the keypoint tensor or the heatmaps (+ offset fields) into the
+*   joint records {x, y, score} rescaled to the letterbox.
+*
+* @retval json  [[[x, y, score], ..], ..] - joints of each pose
+**/
+/**************************************************************************{{{*/
+std::string
+decode_keypoints(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int index;         // keypoint/heatmap tensor
+        unsigned int mode;          // KeypointMode
+        int          offset_index;  // offset tensor [1, H, W, 2K] {y.., x..} or -1
+        float        offset_scale;  // scale to normalize the offset
+        float        rx;            // aspect ratio of the letterbox
+        float        ry;
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    TensorView view;
+    if (prms->index >= sys.mInterp->OutputCount()
+    || !sys.mInterp->get_output_view(prms->index, view)
+    || view.mShape.size() < 2) {
+        res["status"] = -1;
+        return res.dump();
+    }
+
+    sys.start_watch();
+
+    std::vector<float>&& data = view.to_float();
+    const std::vector<int>& shape = view.mShape;
+    const size_t rank = shape.size();
+
+    switch (prms->mode) {
+    case KEYPOINT_YXS:
+    case KEYPOINT_XYS:
+        {
+        if (shape[rank-1] < 3) {
+            res["status"] = -2;
+            return res.dump();
+        }
+        const size_t stride    = shape[rank-1];
+        const size_t num_joint = shape[rank-2];
+        if (num_joint == 0) {
+            // no joint, no pose
+            return json::array().dump();
+        }
+        const size_t num_pose  = data.size()/(num_joint*stride);
+        const bool   yx        = (prms->mode == KEYPOINT_YXS);
+
+        const float* p = data.data();
+        for (size_t pose = 0; pose < num_pose; pose++) {
+            auto joints = json::array();
+            for (size_t k = 0; k < num_joint; k++, p += stride) {
+                float x = yx ? p[1] : p[0];
+                float y = yx ? p[0] : p[1];
+                joints.push_back(joint(x, y, p[2], prms->rx, prms->ry));
+            }
+            res.push_back(joints);
+        }
+        }
+        break;
+
+    case HEATMAP_NHWC:
+    case HEATMAP_NCHW:
+        {
+        if (rank != 4) {
+            res["status"] = -2;
+            return res.dump();
+        }
+        const bool nhwc = (prms->mode == HEATMAP_NHWC);
+        const int  H = nhwc ? shape[1] : shape[2];
+        const int  W = nhwc ? shape[2] : shape[3];
+        const int  K = nhwc ? shape[3] : shape[1];
+        if (H <= 0 || W <= 0) {
+            res["status"] = -2;
+            return res.dump();
+        }
+
+        // element stride of the heatmap k
+        const size_t sx = nhwc ? K : 1;
+        const size_t sy = nhwc ? static_cast<size_t>(W)*K : W;
+        const size_t sk = nhwc ? 1 : static_cast<size_t>(H)*W;
+
+        std::vector<float> offset;
+        if (prms->offset_index >= 0) {
+            TensorView oview;
+            if (static_cast<size_t>(prms->offset_index) >= sys.mInterp->OutputCount()
+            || !sys.mInterp->get_output_view(prms->offset_index, oview)
+            || oview.count() != 2*data.size()) {
+                res["status"] = -3;
+                return res.dump();
+            }
+            offset = oview.to_float();
+        }
+
+        auto joints = json::array();
+        for (int k = 0; k < K; k++) {
+            const float* hm = data.data() + k*sk;
+
+            // peak of the heatmap
+            int   px = 0, py = 0;
+            float peak = -INFINITY;
+            for (int y = 0; y < H; y++) {
+                const float* row = hm + y*sy;
+                for (int x = 0; x < W; x++) {
+                    if (row[x*sx] > peak) {
+                        peak = row[x*sx];
+                        px = x; py = y;
+                    }
+                }
+            }
+
+            float fx = (px + 0.5f)/W;
+            float fy = (py + 0.5f)/H;
+            if (!offset.empty()) {
+                // offset fields: {y0..yK-1, x0..xK-1} per cell
+                size_t cell = nhwc ? (static_cast<size_t>(py)*W + px)*2*K : static_cast<size_t>(py)*W + px;
+                size_t plane = nhwc ? 1 : static_cast<size_t>(H)*W;
+                fy += prms->offset_scale*offset[cell + k*plane];
+                fx += prms->offset_scale*offset[cell + (K + k)*plane];
+            }
+            else {
+                // sub-pixel refinement
+                const float* c = hm + py*sy + px*sx;
+                if (0 < px && px < W-1) { fx += refine(c[-static_cast<ptrdiff_t>(sx)], *c, c[sx])/W; }
+                if (0 < py && py < H-1) { fy += refine(c[-static_cast<ptrdiff_t>(sy)], *c, c[sy])/H; }
+            }
+
+            joints.push_back(joint(fx, fy, peak, prms->rx, prms->ry));
+        }
+        res.push_back(joints);
+        }
+        break;
+
+    default:
+        res["status"] = -2;
+        return res.dump();
+    }
+
+    sys.LAP_OUTPUT();
+
+    return res.dump();
+}
+
+/*** keypoints.cc *********************************************************}}}*/
@@ -15,6 +15,7 @@
 #include <io.h>
 #endif
 
+#include <stdio.h>
 #include <string>
 #include "tiny_ml.h"
 #include "getopt/getopt.h"
@@ -43,6 +44,14 @@ void usage()
       << "      -i <spec> : input tensor spec - \"f4,1,3,224,224\"\n"
       << "      -o <spec> : output tensor spec - \"f4,1,1000\"\n"
       << "      -j <num>  : number of threads\n"
+      << "      -b <num>  : split the batch across <num> interpreters\n"
+      << "      -s <num>  : staging mode with <num> input slots\n"
+      << "      -B <lens> : bucketing mode with the sequence lengths - \"64,128,256\"\n"
+      << "      -x <axis> : sequence axis of the bucketing mode (default 1)\n"
+      << "      -m <num>  : memory budget of the models in MB (0 = unlimited)\n"
+      << "      -q <num>  : bound of the request queue (0 = unbounded)\n"
+      << "      -p <policy> : queue policy when full - reject, drop_oldest, latest\n"
+      << "      -w <spec> : fair share weights of the tenants - \"1:4,2:1\"\n"
       << "      -d <num>  : diagnosis mode\n"
       << "                  1 = save the formed image\n"
       << "                  2 = save model's input/output tensors\n"
@@ -69,6 +78,14 @@ main(int argc, char* argv[])
         {"outputs",  required_argument, NULL, 'o'},
         { "debug",    required_argument, NULL, 'd' },
         { "parallel", required_argument, NULL, 'j' },
+        { "batch_split", required_argument, NULL, 'b' },
+        { "staging",  required_argument, NULL, 's' },
+        { "buckets",  required_argument, NULL, 'B' },
+        { "seq_axis", required_argument, NULL, 'x' },
+        { "memory_budget", required_argument, NULL, 'm' },
+        { "queue",    required_argument, NULL, 'q' },
+        { "queue_policy", required_argument, NULL, 'p' },
+        { "weights",  required_argument, NULL, 'w' },
         {0,0,0,0}
     };
 
@@ -76,13 +93,19 @@ main(int argc, char* argv[])
     gSys.mRuntime   = std::string("Tensorflow-lite") + " " +  TFLITE_VERSION_STRING;
     gSys.mDiag      = 0;
     gSys.mNumThread = 4;
+    gSys.mNumSplit  = 1;
+    gSys.mNumSlot   = 1;
+    gSys.mMemBudget = 0;
+    gSys.mSeqAxis   = 1;
+    gSys.mQueueDepth  = 0;
+    gSys.mQueuePolicy = 0;
     gSys.reset_lap();
 
     std::string inputs;
     std::string outputs;
 
     for (;;) {
-        opt = getopt_long(argc, argv, "i:o:d:j:", longopts, NULL);
+        opt = getopt_long(argc, argv, "i:o:d:j:b:s:B:x:m:q:p:w:", longopts, NULL);
         if (opt == -1) {
             break;
         }
@@ -98,6 +121,48 @@ main(int argc, char* argv[])
         case 'j':
             gSys.mNumThread = atoi(optarg);
             break;
+        case 'b':
+            gSys.mNumSplit = atoi(optarg);
+            break;
+        case 's':
+            gSys.mNumSlot = atoi(optarg);
+            break;
+        case 'B':
+            for (char* item = strtok(optarg, ","); item != NULL; item = strtok(NULL, ",")) {
+                gSys.mBuckets.push_back(atoi(item));
+            }
+            break;
+        case 'x':
+            gSys.mSeqAxis = atoi(optarg);
+            break;
+        case 'm':
+            gSys.mMemBudget = static_cast<size_t>(atof(optarg)*1024*1024);
+            break;
+        case 'q':
+            gSys.mQueueDepth = atoi(optarg);
+            break;
+        case 'p':
+            if (strcmp(optarg, "reject") == 0)           { gSys.mQueuePolicy = 0; }
+            else if (strcmp(optarg, "drop_oldest") == 0) { gSys.mQueuePolicy = 1; }
+            else if (strcmp(optarg, "latest") == 0)      { gSys.mQueuePolicy = 2; }
+            else {
+                std::cerr << "error: unknown queue policy\n\n";
+                usage();
+                return 1;
+            }
+            break;
+        case 'w':
+            for (char* item = strtok(optarg, ","); item != NULL; item = strtok(NULL, ",")) {
+                unsigned int tenant;
+                double       weight;
+                if (sscanf(item, "%u:%lf", &tenant, &weight) != 2 || weight <= 0.0) {
+                    std::cerr << "error: wrong tenant weight\n\n";
+                    usage();
+                    return 1;
+                }
+                gSys.mTenantWeight[tenant] = weight;
+            }
+            break;
         case '?':
         case ':':
             std::cerr << "error: unknown options\n\n";
@@ -82,16 +82,9 @@ public:
         return mScore < b.mScore;
     }
 
-    // put out the scaled BBox in JSON formatting
-    json to_json() const {
-        auto result = json::array();
-        result.push_back(mScore);
-        result.push_back(mBBox[0]);
-        result.push_back(mBBox[1]);
-        result.push_back(mBBox[2]);
-        result.push_back(mBBox[3]);
-        result.push_back(mIndex);
-        return result;
+    // put out the selected box
+    Detection detection() const {
+        return { mIndex, { mBBox[0], mBBox[1], mBBox[2], mBBox[3] }, mScore };
     }
 
 //ACCESSOR:
@@ -123,10 +116,10 @@ bool operator< (const Box& a, const Box& b) {
 * @par DESCRIPTION
 *   run non-maximum on every class
 *
-* @retval json
+* @retval
 **/
 /**************************************************************************{{{*/
-std::string
+void
 non_max_suppression_multi_class(
 unsigned int num_boxes,
 unsigned int box_repr,
@@ -135,9 +128,9 @@ unsigned int num_class,
 const float* scores,
 float         iou_threshold,
 float         score_threshold,
-float         sigma)
+float         sigma,
+std::function<void(unsigned int class_id, const Detection&)> select)
 {
-    json res;
     std::list<Box> candidates;
 
     // run nms over each classification class.
@@ -155,7 +148,6 @@ float         sigma)
         if (candidates.empty()) continue;
 
         // perform iou filtering
-        std::string class_name = gSys.label(class_id);
         bool run_sort = true;
         do {
             if (run_sort) {
@@ -164,7 +156,7 @@ float         sigma)
             }
 
             Box selected = candidates.back(); candidates.pop_back();
-            res[class_name].push_back(selected.to_json());
+            select(class_id, selected.detection());
 
             for (auto it = candidates.begin(); it != candidates.end();) {
                 float iou = selected.iou(*it);
@@ -190,8 +182,6 @@ float         sigma)
             }
         } while (!candidates.empty());
     }
-
-    return res.dump();
 }
 
 /***  Module Header  ******************************************************}}}*/
@@ -218,7 +208,8 @@ non_max_suppression_multi_class(SysInfo&, const void* args)
     });
     const Prms*  prms = reinterpret_cast<const Prms*>(args);
 
-    return non_max_suppression_multi_class(
+    json res;
+    non_max_suppression_multi_class(
         prms->num_boxes,
         prms->box_repr,
         &prms->table[0],
@@ -226,8 +217,12 @@ non_max_suppression_multi_class(SysInfo&, const void* args)
         &prms->table[4*prms->num_boxes],
         prms->iou_threshold,
         prms->score_threshold,
-        prms->sigma
+        prms->sigma,
+        [&res](unsigned int class_id, const Detection& det) {
+            res[gSys.label(class_id)].push_back(det.to_json());
+        }
     );
+    return res.dump();
 }
 
 /*** nonmaxsuppression.cc *************************************************}}}*/
@@ -0,0 +1,1019 @@
+/***  File Header  ************************************************************/
+/**
+* pipeline.cc
+*
+* Elixir/Erlang Port ext. of Tiny ML: model chaining pipeline
+* @author      Shozo Fukuda
+* @date create Wed Oct 22 09:41:18 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include <map>
+#include <set>
+#include <array>
+#include <algorithm>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "tiny_ml.h"
+#include "preprocess.h"
+#include "postprocess.h"
+#include "registry.h"
+#include "pipeline.h"
+
+/***  Type ****************************************************************}}}*/
+/**
+* tensor flowing between the stages
+**/
+/**************************************************************************{{{*/
+struct Blob {
+    std::string       mData;
+    TensorSpec::DType mDType { TensorSpec::DTYPE_NONE };    // NONE = raw binary from the client
+    std::vector<int>  mShape;
+    float             mScale { 0.0f };
+    int               mZeroPoint { 0 };
+
+    // the raw binary is taken as a flat float32 array
+    TensorView view() const {
+        TensorView view;
+        view.mDType     = (mDType != TensorSpec::DTYPE_NONE) ? mDType : TensorSpec::DTYPE_F32;
+        view.mShape     = (mDType != TensorSpec::DTYPE_NONE) ? mShape : std::vector<int>{ static_cast<int>(mData.size()/sizeof(float)) };
+        view.mData      = reinterpret_cast<uint8_t*>(const_cast<char*>(mData.data()));
+        view.mBytes     = mData.size();
+        view.mScale     = mScale;
+        view.mZeroPoint = mZeroPoint;
+        return view;
+    }
+};
+
+// "stage:index" - the tensor "index" of the stage, "in" is the inputs of the pipeline
+struct Ref {
+    std::string  mStage;
+    unsigned int mIndex { 0 };
+};
+
+enum StageOp {
+    STAGE_MODEL = 0,            // run the model
+    STAGE_NMS,                  // select the boxes
+    STAGE_ROI,                  // run the model on the crops of the frame
+};
+
+struct Stage {
+    StageOp      mOp { STAGE_MODEL };
+    std::string  mName;
+
+    // model/roi
+    unsigned int mModel { 0 };
+    std::vector<std::pair<unsigned int, Ref>> mInputs;  // input index <- tensor
+    int          mImage { -1 };                         // input index filled from the frame
+    ImageOpts    mOpts;
+
+    // nms/roi
+    Ref          mBoxes;
+    Ref          mScores;
+    unsigned int mBoxRepr { 2 };
+    float        mIou { 0.5f };
+    float        mScore { 0.25f };
+    float        mSigma { 0.0f };
+    float        mSize[2] { 1.0f, 1.0f };   // scale of the boxes to normalize them
+    unsigned int mMaxBoxes { 0 };           // 0 = no limit
+
+    // parallel
+    int          mThread { 0 };             // threads of the stage's interpreter, 0 = the model's
+};
+
+struct Pipeline {
+    std::vector<Stage> mStages;             // in the topological order
+    std::vector<Ref>   mOutputs;
+    bool               mParallel { false }; // run the stages on their own threads
+    size_t             mDepth { 2 };        // bound of the queues between the stages
+};
+
+static std::map<unsigned int, Pipeline> gPipelines;
+
+// values of the running pipeline
+struct Context {
+    uint32_t          mTag { 0 };           // the request
+    chrono::steady_clock::time_point mDeadline;
+    int               mStatus { 0 };
+
+    const ImageFrame* mFrame { nullptr };
+    std::map<std::string, std::vector<Blob>>            mValues;
+    std::map<std::string, std::array<float, 2>>         mAspect;    // of the frame in the input tensor
+
+    // own copy of the frame, the cache may be updated by the next frame
+    std::vector<uint8_t> mPixels;
+    ImageFrame           mSnapshot;
+
+    void snapshot() {
+        if (mFrame == nullptr) {
+            return;
+        }
+        mPixels.assign(mFrame->mData, mFrame->mData + static_cast<size_t>(mFrame->mWidth)*mFrame->mHeight*mFrame->mChannel);
+        mSnapshot       = *mFrame;
+        mSnapshot.mData = mPixels.data();
+        mFrame          = &mSnapshot;
+    }
+
+    const Blob* find(const Ref& ref) const {
+        auto it = mValues.find(ref.mStage);
+        return (it != mValues.end() && ref.mIndex < it->second.size()) ? &it->second[ref.mIndex] : nullptr;
+    }
+};
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* copy the tensor out of the interpreter
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+static Blob
+to_blob(const TensorView& view)
+{
+    Blob blob;
+    blob.mData.assign(reinterpret_cast<const char*>(view.mData), view.mBytes);
+    blob.mDType     = view.mDType;
+    blob.mShape     = view.mShape;
+    blob.mScale     = view.mScale;
+    blob.mZeroPoint = view.mZeroPoint;
+    return blob;
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* parse the tensor reference "stage:index"
+* @par DESCRIPTION
+*   "stage" is the same as "stage:0".
+*
+* @retval true  the reference to the known stage
+* @retval false bad reference
+**/
+/**************************************************************************{{{*/
+static bool
+parse_ref(const json& item, const std::set<std::string>& known, Ref& ref)
+{
+    if (!item.is_string()) {
+        return false;
+    }
+    std::string text = item.get<std::string>();
+    size_t pos = text.rfind(':');
+    ref.mStage = text.substr(0, pos);
+    ref.mIndex = 0;
+    if (pos != std::string::npos) {
+        const std::string index = text.substr(pos + 1);
+        if (index.empty() || index.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        ref.mIndex = std::stoul(index);
+    }
+    return known.count(ref.mStage) > 0;
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* parse the options to put the frame into the input tensor
+* @par DESCRIPTION
+*   the defaults are the raw pixel values [0..255] in NHWC.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+static void
+parse_image_opts(const json& item, ImageOpts& opts)
+{
+    static const std::map<std::string, unsigned int> fit    = { {"stretch", 0}, {"letterbox", 1} };
+    static const std::map<std::string, unsigned int> filter = { {"bilinear", 0}, {"area", 1}, {"nearest", 2} };
+    static const std::map<std::string, unsigned int> layout = { {"nhwc", 0}, {"nchw", 1} };
+
+    memset(&opts, 0, sizeof(opts));
+    for (int c = 0; c < 4; c++) { opts.std[c] = 1.0f; }
+
+    auto it = fit.find(item.value("fit", "stretch"));
+    opts.fit = (it != fit.end()) ? it->second : 0;
+    it = filter.find(item.value("filter", "bilinear"));
+    opts.filter = (it != filter.end()) ? it->second : 0;
+    it = layout.find(item.value("layout", "nhwc"));
+    opts.nchw = (it != layout.end()) ? it->second : 0;
+    opts.bgr = item.value("bgr", false) ? 1 : 0;
+    opts.pad = item.value("pad", 0.0f);
+
+    // the last value is repeated for the rest channels. ImageOpts is packed,
+    // so the values go through the local array
+    auto channels = [](const json& values, float* res) {
+        for (size_t c = 0; c < 4 && !values.empty(); c++) {
+            res[c] = values[std::min(c, values.size() - 1)].get<float>();
+        }
+    };
+    float value[4];
+    if (item.contains("mean")) {
+        memcpy(value, opts.mean, sizeof(value));
+        channels(item["mean"], value);
+        memcpy(opts.mean, value, sizeof(value));
+    }
+    if (item.contains("std")) {
+        memcpy(value, opts.std, sizeof(value));
+        channels(item["std"], value);
+        memcpy(opts.std, value, sizeof(value));
+    }
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* parse the pipeline definition
+* @par DESCRIPTION
+*   {"stages": [stage..], "outputs": ["stage:index"..]}
+*
+*   model: {"name", "model": id, "inputs": {"index": "stage:index"..},
+*           "image": index, "image_opts": {..}}
+*   nms:   {"name", "op": "nms", "boxes": ref, "scores": ref, "box_repr": 0|1|2,
+*           "iou", "score", "sigma", "size": [w, h], "max_boxes"}
+*   roi:   {"name", "op": "roi", "model": id, "boxes": ref, "image": index,
+*           "image_opts": {..}, "inputs": {..}, "max_boxes"}
+*
+*   image_opts: {"fit": "stretch"|"letterbox", "filter": "bilinear"|"area"|"nearest",
+*                "layout": "nhwc"|"nchw", "bgr", "pad", "mean": [..], "std": [..]}
+*   the stage refers only to the stages before it.
+*
+*   "parallel": true runs the stages on their own threads and interpreters
+*   ("threads" of each model/roi stage) with the queues of "queue" jobs
+*   between them.
+*
+* @retval "" success
+* @retval error message
+**/
+/**************************************************************************{{{*/
+static std::string
+parse_pipeline(const json& spec, Pipeline& pipeline)
+{
+    static const std::map<std::string, StageOp> ops = { {"model", STAGE_MODEL}, {"nms", STAGE_NMS}, {"roi", STAGE_ROI} };
+
+    std::set<std::string> known = { "in" };
+
+    for (const auto& item : spec.at("stages")) {
+        Stage stage;
+        stage.mName = item.at("name").get<std::string>();
+        if (known.count(stage.mName) > 0) {
+            return "duplicated stage: " + stage.mName;
+        }
+
+        auto op = ops.find(item.value("op", "model"));
+        if (op == ops.end()) {
+            return "unknown op: " + stage.mName;
+        }
+        stage.mOp = op->second;
+
+        if (stage.mOp != STAGE_NMS) {
+            stage.mModel  = item.at("model").get<unsigned int>();
+            stage.mThread = item.value("threads", 0);
+            stage.mImage = item.value("image", (stage.mOp == STAGE_ROI) ? 0 : -1);
+            parse_image_opts(item.value("image_opts", json::object()), stage.mOpts);
+
+            for (const auto& bind : item.value("inputs", json::object()).items()) {
+                Ref ref;
+                if (!parse_ref(bind.value(), known, ref)) {
+                    return "bad input of " + stage.mName;
+                }
+                stage.mInputs.emplace_back(std::stoul(bind.key()), ref);
+            }
+        }
+
+        if (stage.mOp != STAGE_MODEL) {
+            if (!parse_ref(item.at("boxes"), known, stage.mBoxes)) {
+                return "bad boxes of " + stage.mName;
+            }
+            stage.mMaxBoxes = item.value("max_boxes", 0u);
+        }
+
+        if (stage.mOp == STAGE_NMS) {
+            if (!parse_ref(item.at("scores"), known, stage.mScores)) {
+                return "bad scores of " + stage.mName;
+            }
+            stage.mBoxRepr = item.value("box_repr", 2u);
+            stage.mIou     = item.value("iou", 0.5f);
+            stage.mScore   = item.value("score", 0.25f);
+            stage.mSigma   = item.value("sigma", 0.0f);
+            if (item.contains("size")) {
+                stage.mSize[0] = item["size"].at(0).get<float>();
+                stage.mSize[1] = item["size"].at(1).get<float>();
+            }
+        }
+
+        known.insert(stage.mName);
+        pipeline.mStages.push_back(stage);
+    }
+
+    for (const auto& item : spec.at("outputs")) {
+        Ref ref;
+        if (!parse_ref(item, known, ref)) {
+            return "bad output";
+        }
+        pipeline.mOutputs.push_back(ref);
+    }
+
+    pipeline.mParallel = spec.value("parallel", false);
+    pipeline.mDepth    = std::max<size_t>(1, spec.value("queue", 2u));
+
+    return "";
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* prepare the model of the stage
+* @par DESCRIPTION
+*   inherit the request and bind the inputs. the bound blob must fill the
+*   input, except the sequence input of the bucketing mode.
+*
+* @retval 0  success
+* @retval <0 error
+**/
+/**************************************************************************{{{*/
+static int
+prepare_model(TinyMLInterp* interp, const Stage& stage, const Context& ctx)
+{
+    interp->set_request(ctx.mTag, ctx.mDeadline);
+    int status = interp->check_cancel();
+    if (status < 0) {
+        return status;
+    }
+
+    for (const auto& bind : stage.mInputs) {
+        const Blob* blob = ctx.find(bind.second);
+        if (blob == nullptr || bind.first >= interp->InputCount()) {
+            return -2;
+        }
+
+        // the whole input, or the head of the sequence to pad (bucketing)
+        bool   prefix = false;
+        size_t bytes  = interp->input_bytes(bind.first, &prefix);
+        size_t size   = blob->mData.size();
+        if (prefix ? (size == 0 || size > bytes) : (size != bytes)) {
+            return -2;
+        }
+        if (interp->set_input_tensor(bind.first, reinterpret_cast<const uint8_t*>(blob->mData.data()), static_cast<int>(size)) < 0) {
+            return -2;
+        }
+    }
+    return 0;
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* stage: run the model
+* @par DESCRIPTION
+*
+*
+* @retval 0  success
+* @retval <0 error
+**/
+/**************************************************************************{{{*/
+static int
+run_model_stage(TinyMLInterp* interp, const Stage& stage, Context& ctx, std::vector<Blob>& outputs)
+{
+    int status = prepare_model(interp, stage, ctx);
+    if (status < 0) {
+        return status;
+    }
+
+    if (stage.mImage >= 0) {
+        TensorView tensor;
+        if (ctx.mFrame == nullptr
+        ||  static_cast<size_t>(stage.mImage) >= interp->InputCount()
+        || !interp->get_input_view(stage.mImage, tensor)) {
+            return -1;
+        }
+        status = image_to_tensor(*ctx.mFrame, stage.mOpts, tensor, 0, ctx.mAspect[stage.mName].data());
+        if (status < 0) {
+            return status;
+        }
+    }
+
+    status = interp->invoke();
+    if (status < 0) {
+        return status;
+    }
+
+    for (unsigned int index = 0; index < interp->OutputCount(); index++) {
+        TensorView view;
+        if (!interp->get_output_view(index, view)) {
+            return -2;
+        }
+        outputs.push_back(to_blob(view));
+    }
+    return 0;
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* stage: non maximum suppression
+* @par DESCRIPTION
+*   the selected boxes are normalized to the frame by "size" and the aspect
+*   of the frame in the input tensor of the box stage.
+*
+* @retval 0  success, outputs f32 [n, 6] {x1, y1, x2, y2, score, class} in descending score
+* @retval <0 error
+**/
+/**************************************************************************{{{*/
+static int
+run_nms_stage(const Stage& stage, Context& ctx, std::vector<Blob>& outputs)
+{
+    const Blob* boxes  = ctx.find(stage.mBoxes);
+    const Blob* scores = ctx.find(stage.mScores);
+    if (boxes == nullptr || scores == nullptr) {
+        return -2;
+    }
+
+    std::vector<float> box   = boxes->view().to_float();
+    std::vector<float> score = scores->view().to_float();
+    const size_t num_boxes = box.size()/4;
+    if (num_boxes == 0 || score.size() % num_boxes != 0) {
+        return -2;
+    }
+    const size_t num_class = score.size()/num_boxes;
+
+    std::array<float, 2> aspect = { 1.0f, 1.0f };
+    auto it = ctx.mAspect.find(stage.mBoxes.mStage);
+    if (it != ctx.mAspect.end()) {
+        aspect = it->second;
+    }
+    const float sx = 1.0f/(stage.mSize[0]*aspect[0]);
+    const float sy = 1.0f/(stage.mSize[1]*aspect[1]);
+
+    // the selections come class by class, so "max_boxes" keeps the top
+    // scores over all classes
+    std::vector<std::pair<unsigned int, Detection>> detections;
+    non_max_suppression_multi_class(
+        static_cast<unsigned int>(num_boxes), stage.mBoxRepr, box.data(),
+        static_cast<unsigned int>(num_class), score.data(),
+        stage.mIou, stage.mScore, stage.mSigma,
+        [&](unsigned int class_id, const Detection& det) {
+            detections.emplace_back(class_id, det);
+        }
+    );
+    std::stable_sort(detections.begin(), detections.end(), [](const auto& a, const auto& b) {
+        return a.second.mScore > b.second.mScore;
+    });
+    if (stage.mMaxBoxes > 0 && detections.size() > stage.mMaxBoxes) {
+        detections.resize(stage.mMaxBoxes);
+    }
+
+    std::vector<float> selected;
+    for (const auto& item : detections) {
+        const Detection& det = item.second;
+        selected.push_back(std::min(1.0f, std::max(0.0f, det.mBBox[0]*sx)));
+        selected.push_back(std::min(1.0f, std::max(0.0f, det.mBBox[1]*sy)));
+        selected.push_back(std::min(1.0f, std::max(0.0f, det.mBBox[2]*sx)));
+        selected.push_back(std::min(1.0f, std::max(0.0f, det.mBBox[3]*sy)));
+        selected.push_back(det.mScore);
+        selected.push_back(static_cast<float>(item.first));
+    }
+
+    Blob blob;
+    blob.mData.assign(reinterpret_cast<const char*>(selected.data()), selected.size()*sizeof(float));
+    blob.mDType = TensorSpec::DTYPE_F32;
+    blob.mShape = { static_cast<int>(selected.size()/6), 6 };
+    outputs.push_back(blob);
+    return 0;
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* stage: run the model on the crops of the frame
+* @par DESCRIPTION
+*   crop the boxes {x1, y1, x2, y2, ..} normalized to the frame, and run
+*   them N at a time along the batch of the input tensor like run_rois.
+*   the outputs are stacked along the boxes.
+*
+* @retval 0  success
+* @retval <0 error
+**/
+/**************************************************************************{{{*/
+static int
+run_roi_stage(TinyMLInterp* interp, const Stage& stage, Context& ctx, std::vector<Blob>& outputs)
+{
+    const Blob* boxes = ctx.find(stage.mBoxes);
+    if (boxes == nullptr || ctx.mFrame == nullptr) {
+        return -1;
+    }
+    TensorView boxes_view = boxes->view();
+    std::vector<float> box = boxes_view.to_float();
+    const size_t width = (boxes_view.mShape.size() >= 2) ? boxes_view.mShape.back() : 4;
+    if (width < 4) {
+        return -2;
+    }
+    size_t num_box = box.size()/width;
+    if (stage.mMaxBoxes > 0) {
+        num_box = std::min<size_t>(num_box, stage.mMaxBoxes);
+    }
+
+    int status = prepare_model(interp, stage, ctx);
+    if (status < 0) {
+        return status;
+    }
+
+    TensorView tensor;
+    if (static_cast<size_t>(stage.mImage) >= interp->InputCount()
+    || !interp->get_input_view(stage.mImage, tensor)) {
+        return -1;
+    }
+    const size_t batch = (tensor.mShape.size() == 4) ? tensor.mShape[0] : 1;
+    const ImageFrame& frame = *ctx.mFrame;
+
+    outputs.resize(interp->OutputCount());
+    for (unsigned int index = 0; index < outputs.size(); index++) {
+        TensorView view;
+        if (!interp->get_output_view(index, view)) {
+            return -2;
+        }
+        outputs[index].mDType     = view.mDType;
+        outputs[index].mScale     = view.mScale;
+        outputs[index].mZeroPoint = view.mZeroPoint;
+        outputs[index].mShape     = view.mShape;
+        if (outputs[index].mShape.empty()) {
+            outputs[index].mShape.push_back(1);
+        }
+        outputs[index].mShape[0] = static_cast<int>(num_box);
+    }
+
+    ImageOpts opts = stage.mOpts;
+    for (size_t base = 0; base < num_box; base += batch) {
+        const size_t n = std::min(batch, num_box - base);
+
+        for (size_t b = 0; b < n; b++) {
+            box_to_roi(&box[width*(base + b)], frame, opts);
+
+            float aspect[2];
+            status = image_to_tensor(frame, opts, tensor, b, aspect);
+            if (status < 0) {
+                return status;
+            }
+        }
+
+        status = interp->invoke();
+        if (status < 0) {
+            return status;
+        }
+
+        for (unsigned int index = 0; index < outputs.size(); index++) {
+            TensorView view;
+            if (!interp->get_output_view(index, view)) {
+                return -2;
+            }
+            const size_t size = view.mBytes/batch;
+            outputs[index].mData.append(reinterpret_cast<const char*>(view.mData), n*size);
+        }
+    }
+
+    return 0;
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* run the stage
+* @par DESCRIPTION
+*   "interp" is the model of the model/roi stage.
+*
+* @retval 0  success
+* @retval <0 error
+**/
+/**************************************************************************{{{*/
+static int
+run_stage(TinyMLInterp* interp, const Stage& stage, Context& ctx)
+{
+    std::vector<Blob>& outputs = ctx.mValues[stage.mName];
+
+    switch (stage.mOp) {
+    case STAGE_MODEL: return run_model_stage(interp, stage, ctx, outputs);
+    case STAGE_NMS:   return run_nms_stage(stage, ctx, outputs);
+    case STAGE_ROI:   return run_roi_stage(interp, stage, ctx, outputs);
+    default:          return -2;
+    }
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* reply of the pipeline
+* @par DESCRIPTION
+*
+*
+* @retval binary  <<count::32, {size::32, bin}..>>
+* @retval binary  <<error_code::s32>>
+**/
+/**************************************************************************{{{*/
+static std::string
+error_code(int status)
+{
+    return std::string(reinterpret_cast<char*>(&status), sizeof(status));
+}
+
+static std::string
+pipeline_outputs(const Pipeline& pipeline, const Context& ctx)
+{
+    if (ctx.mStatus < 0) {
+        return error_code(ctx.mStatus);
+    }
+
+    uint32_t count = static_cast<uint32_t>(pipeline.mOutputs.size());
+    std::string output(reinterpret_cast<char*>(&count), sizeof(count));
+    for (const Ref& ref : pipeline.mOutputs) {
+        const Blob* blob = ctx.find(ref);
+        if (blob == nullptr) {
+            return error_code(-2);
+        }
+        uint32_t size = static_cast<uint32_t>(blob->mData.size());
+        output += std::string(reinterpret_cast<char*>(&size), sizeof(size))
+               +  blob->mData;
+    }
+    return output;
+}
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* bounded queue of the jobs between the stages
+* @par DESCRIPTION
+*   push blocks while it is full, so the slowest stage paces the upstream.
+**/
+/**************************************************************************{{{*/
+class JobQueue {
+//LIFECYCLE:
+public:
+    JobQueue(size_t depth) : mDepth(depth) {}
+
+//ACTION:
+public:
+    void push(std::unique_ptr<Context> job) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNotFull.wait(lock, [this]{ return mQueue.size() < mDepth; });
+        mQueue.push_back(std::move(job));
+        mNotEmpty.notify_one();
+    }
+
+    // return false if it is closed and empty
+    bool pop(std::unique_ptr<Context>& job) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNotEmpty.wait(lock, [this]{ return !mQueue.empty() || mClosed; });
+        if (mQueue.empty()) {
+            return false;
+        }
+        job = std::move(mQueue.front());
+        mQueue.pop_front();
+        mNotFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+        mNotEmpty.notify_all();
+    }
+
+//ATTRIBUTE:
+private:
+    std::mutex              mMutex;
+    std::condition_variable mNotFull;
+    std::condition_variable mNotEmpty;
+    std::deque<std::unique_ptr<Context>> mQueue;
+    size_t                  mDepth;
+    bool                    mClosed { false };
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* pipeline-parallel runner
+* @par DESCRIPTION
+*   every stage runs on its own thread with its own interpreter, and the
+*   jobs flow through the bounded queues between the stages. while stage 2
+*   works on frame N, stage 1 works on frame N+1, so the throughput is that
+*   of the slowest stage. the last stage replies to the request.
+**/
+/**************************************************************************{{{*/
+class PipelineRunner {
+//LIFECYCLE:
+public:
+    PipelineRunner(const Pipeline& pipeline) : mPipeline(pipeline) {}
+
+    ~PipelineRunner() {
+        // the jobs in the queues run to the end
+        if (!mQueue.empty()) {
+            mQueue.front()->close();
+        }
+        for (auto& thread : mThread) {
+            thread.join();
+        }
+    }
+
+    // make the interpreters and start the stages
+    bool start() {
+        for (const Stage& stage : mPipeline.mStages) {
+            TinyMLInterp* interp = nullptr;
+            if (stage.mOp != STAGE_NMS) {
+                interp = clone_model(stage.mModel, stage.mThread);
+                if (interp == nullptr) {
+                    return false;
+                }
+            }
+            mInterp.emplace_back(interp);
+        }
+
+        for (size_t i = 0; i < mPipeline.mStages.size(); i++) {
+            mQueue.emplace_back(new JobQueue(mPipeline.mDepth));
+        }
+        for (size_t i = 0; i < mPipeline.mStages.size(); i++) {
+            mThread.emplace_back(&PipelineRunner::stage_loop, this, i);
+        }
+        return true;
+    }
+
+//ACTION:
+public:
+    void push(std::unique_ptr<Context> job) {
+        mQueue.front()->push(std::move(job));
+    }
+
+    void cancel(uint32_t tag) {
+        for (auto& interp : mInterp) {
+            if (interp) { interp->cancel(tag); }
+        }
+    }
+
+private:
+    void stage_loop(size_t index) {
+        const Stage& stage = mPipeline.mStages[index];
+        const bool   last  = (index + 1 == mPipeline.mStages.size());
+
+        std::unique_ptr<Context> job;
+        while (mQueue[index]->pop(job)) {
+            if (job->mStatus == 0) {
+                job->mStatus = run_stage(mInterp[index].get(), stage, *job);
+            }
+
+            if (last) {
+                send_reply(job->mTag, 0, pipeline_outputs(mPipeline, *job));
+            }
+            else {
+                mQueue[index + 1]->push(std::move(job));
+            }
+        }
+
+        if (!last) {
+            mQueue[index + 1]->close();
+        }
+    }
+
+//ATTRIBUTE:
+private:
+    Pipeline mPipeline;
+    std::vector<std::unique_ptr<TinyMLInterp>> mInterp;     // of the stages, nullptr for nms
+    std::vector<std::unique_ptr<JobQueue>>     mQueue;      // input of the stages
+    std::vector<std::thread>                   mThread;
+};
+
+static std::mutex gRunnerMutex;
+static std::map<unsigned int, std::unique_ptr<PipelineRunner>> gRunners;
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* stop the runner of the pipeline
+* @par DESCRIPTION
+*   it returns after the jobs in the runner are done.
+**/
+/**************************************************************************{{{*/
+static void
+stop_runner(unsigned int id)
+{
+    std::unique_ptr<PipelineRunner> runner;
+    {
+        std::lock_guard<std::mutex> lock(gRunnerMutex);
+        auto it = gRunners.find(id);
+        if (it == gRunners.end()) {
+            return;
+        }
+        runner = std::move(it->second);
+        gRunners.erase(it);
+    }
+    // the stages are joined here, out of the lock
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* define the pipeline
+* @par DESCRIPTION
+*   the pipeline is kept under the id until drop_pipeline. see parse_pipeline
+*   for the definition. the models are referred by the model id of the
+*   registry, so they may be loaded later. the parallel pipeline makes its
+*   own interpreters of the models now.
+*
+* @retval json  {"status": 0} | {"status": -1..-3, "error": message}
+**/
+/**************************************************************************{{{*/
+std::string
+define_pipeline(SysInfo&, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int id;
+        unsigned int size;
+        char         spec[1];       // json
+    });
+    const Prms* prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    json spec = json::parse(std::string(prms->spec, prms->size), nullptr, false);
+    if (spec.is_discarded()) {
+        res["status"] = -1;
+        res["error"]  = "bad json";
+        return res.dump();
+    }
+
+    Pipeline pipeline;
+    std::string error;
+    try {
+        error = parse_pipeline(spec, pipeline);
+    }
+    catch (std::exception& e) {
+        error = e.what();
+    }
+    if (!error.empty()) {
+        res["status"] = -2;
+        res["error"]  = error;
+        return res.dump();
+    }
+
+    stop_runner(prms->id);
+    gPipelines[prms->id] = pipeline;
+
+    if (pipeline.mParallel) {
+        std::unique_ptr<PipelineRunner> runner(new PipelineRunner(pipeline));
+        if (!runner->start()) {
+            gPipelines.erase(prms->id);
+            res["status"] = -3;
+            res["error"]  = "can't load the models";
+            return res.dump();
+        }
+
+        std::lock_guard<std::mutex> lock(gRunnerMutex);
+        gRunners[prms->id] = std::move(runner);
+    }
+
+    res["status"] = 0;
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* run the pipeline
+* @par DESCRIPTION
+*   run the stages end to end on the inputs and the cached frame, and return
+*   only the outputs of the pipeline. the intermediate tensors stay in the
+*   process.
+*   the parallel pipeline takes the job and returns at once. the reply comes
+*   from the last stage. it waits while the first stage queue is full.
+*
+* @retval binary  <<count::32, {size::32, bin}..>>
+* @retval binary  <<error_code::s32>> - error {-1..-3, -11..-13, -16, -17}
+**/
+/**************************************************************************{{{*/
+std::string
+run_pipeline(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int  id;
+        unsigned int  frame;        // handle of the cached frame
+        unsigned int  count;
+        unsigned char data[1];      // {size::32, bin}..
+    });
+    const Prms* prms = reinterpret_cast<const Prms*>(args);
+
+    auto it = gPipelines.find(prms->id);
+    if (it == gPipelines.end()) {
+        return error_code(-1);
+    }
+    const Pipeline& pipeline = it->second;
+
+    sys.start_watch();
+
+    std::unique_ptr<Context> ctx(new Context);
+    ctx->mTag      = sys.mTag;
+    ctx->mDeadline = sys.mDeadline;
+    ctx->mFrame    = find_frame(prms->frame);
+
+    const unsigned char* ptr = prms->data;
+    std::vector<Blob>& inputs = ctx->mValues["in"];
+    for (unsigned int i = 0; i < prms->count; i++) {
+        unsigned int size = *reinterpret_cast<const unsigned int*>(ptr);
+        Blob blob;
+        blob.mData.assign(reinterpret_cast<const char*>(ptr + sizeof(size)), size);
+        inputs.push_back(blob);
+        ptr += sizeof(size) + size;
+    }
+
+    if (pipeline.mParallel) {
+        PipelineRunner* runner;
+        {
+            std::lock_guard<std::mutex> lock(gRunnerMutex);
+            runner = gRunners[prms->id].get();
+        }
+        ctx->snapshot();
+        runner->push(std::move(ctx));
+
+        sys.LAP_INPUT();
+        sys.mDeferred = true;
+        return "";
+    }
+
+    sys.LAP_INPUT();
+
+    for (const Stage& stage : pipeline.mStages) {
+        TinyMLInterp* interp = nullptr;
+        if (stage.mOp != STAGE_NMS) {
+            ctx->mStatus = select_model(sys, stage.mModel, true);
+            if (ctx->mStatus < 0) {
+                break;
+            }
+            interp = sys.mInterp;
+        }
+
+        ctx->mStatus = run_stage(interp, stage, *ctx);
+        if (ctx->mStatus < 0) {
+            break;
+        }
+    }
+
+    sys.LAP_EXEC();
+
+    std::string output = pipeline_outputs(pipeline, *ctx);
+
+    sys.LAP_OUTPUT();
+
+    return output;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* drop the pipeline
+* @par DESCRIPTION
+*   the jobs in the parallel pipeline run to the end.
+*
+* @retval json  {"status": 0}
+**/
+/**************************************************************************{{{*/
+std::string
+drop_pipeline(SysInfo&, const void* args)
+{
+    struct Prms {
+        unsigned int id;
+    };
+    const Prms* prms = reinterpret_cast<const Prms*>(args);
+
+    stop_runner(prms->id);
+
+    json res;
+    res["status"] = (gPipelines.erase(prms->id) > 0) ? 0 : -1;
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* cancel the request running in the parallel pipelines
+* @par DESCRIPTION
+*   called from the receiver thread.
+**/
+/**************************************************************************{{{*/
+void
+cancel_pipelines(uint32_t tag)
+{
+    std::lock_guard<std::mutex> lock(gRunnerMutex);
+    for (auto& item : gRunners) {
+        item.second->cancel(tag);
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* stop all pipelines
+* @par DESCRIPTION
+*   the jobs in the parallel pipelines run to the end.
+**/
+/**************************************************************************{{{*/
+void
+clear_pipelines()
+{
+    std::map<unsigned int, std::unique_ptr<PipelineRunner>> runners;
+    {
+        std::lock_guard<std::mutex> lock(gRunnerMutex);
+        runners.swap(gRunners);
+    }
+    runners.clear();
+    gPipelines.clear();
+}
+
+/*** pipeline.cc **********************************************************}}}*/
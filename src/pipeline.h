@@ -0,0 +1,32 @@
+/***  File Header  ************************************************************/
+/**
+* pipeline.h
+*
+* model chaining - run the graph of the models in one request
+* @author      Shozo Fukuda
+* @date create Wed Oct 22 09:41:18 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+*******************************************************************************/
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+
+/**************************************************************************}}}**
+* model chaining pipeline
+***************************************************************************{{{*/
+std::string define_pipeline(SysInfo& sys, const void* args);
+std::string run_pipeline(SysInfo& sys, const void* args);
+std::string drop_pipeline(SysInfo& sys, const void* args);
+
+void cancel_pipelines(uint32_t tag);
+void clear_pipelines();
+
+#define PIPELINE \
+    define_pipeline, \
+    run_pipeline, \
+    drop_pipeline
+
+// the commands which select the models by themselves
+#define IS_PIPELINE_CMD(f) ((f) == define_pipeline || (f) == run_pipeline || (f) == drop_pipeline)
+
+#endif /* _PIPELINE_H */
@@ -0,0 +1,335 @@
+/***  File Header  ************************************************************/
+/**
+* postop.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: post processing
+* @author      Shozo Fukuda
+* @date create Sat Oct 18 10:12:31 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "postprocess.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+/***  Type ****************************************************************}}}*/
+/**
+* intermediate result of the post-op chain
+**/
+/**************************************************************************{{{*/
+struct PostOpBlob {
+    std::vector<int>   mShape;
+    std::vector<float> mValue;
+    std::vector<int>   mIndex;     // index along the reduced axis, or flat index
+
+    // split the shape into {outer, axis, inner}
+    void split(int axis, size_t& outer, size_t& n, size_t& inner) const {
+        outer = 1; inner = 1;
+        for (int i = 0; i < axis; i++)                              { outer *= mShape[i]; }
+        n = mShape[axis];
+        for (int i = axis+1; i < static_cast<int>(mShape.size()); i++) { inner *= mShape[i]; }
+    }
+
+    // normalize the negative axis
+    int axis(int axis) const {
+        int rank = static_cast<int>(mShape.size());
+        if (axis < 0) { axis += rank; }
+        return (0 <= axis && axis < rank) ? axis : -1;
+    }
+};
+
+enum PostOpCode {
+    POSTOP_SOFTMAX = 0,
+    POSTOP_SIGMOID,
+    POSTOP_ARGMAX,
+    POSTOP_TOPK,
+    POSTOP_THRESHOLD,
+    POSTOP_CAST,
+};
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* softmax along the axis
+* @par DESCRIPTION
+*   the inner loop runs over the contiguous elements to be auto-vectorized.
+**/
+/**************************************************************************{{{*/
+static bool
+postop_softmax(PostOpBlob& blob, int axis)
+{
+    if ((axis = blob.axis(axis)) < 0) { return false; }
+
+    size_t outer, n, inner;
+    blob.split(axis, outer, n, inner);
+
+    std::vector<float> vmax(inner), vsum(inner);
+    for (size_t o = 0; o < outer; o++) {
+        float* base = blob.mValue.data() + o*n*inner;
+
+        std::fill(vmax.begin(), vmax.end(), -INFINITY);
+        for (size_t k = 0; k < n; k++) {
+            const float* row = base + k*inner;
+            for (size_t i = 0; i < inner; i++) { vmax[i] = std::max(vmax[i], row[i]); }
+        }
+
+        std::fill(vsum.begin(), vsum.end(), 0.0f);
+        for (size_t k = 0; k < n; k++) {
+            float* row = base + k*inner;
+            for (size_t i = 0; i < inner; i++) {
+                row[i] = std::exp(row[i] - vmax[i]);
+                vsum[i] += row[i];
+            }
+        }
+
+        for (size_t i = 0; i < inner; i++) { vsum[i] = 1.0f/vsum[i]; }
+        for (size_t k = 0; k < n; k++) {
+            float* row = base + k*inner;
+            for (size_t i = 0; i < inner; i++) { row[i] *= vsum[i]; }
+        }
+    }
+
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* sigmoid of every element
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+static bool
+postop_sigmoid(PostOpBlob& blob)
+{
+    float* p = blob.mValue.data();
+    for (size_t i = 0, n = blob.mValue.size(); i < n; i++) {
+        p[i] = 1.0f/(1.0f + std::exp(-p[i]));
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* top-k along the axis
+* @par DESCRIPTION
+*   the axis is reduced to k elements sorted in descending order.
+*   argmax is top-k with k = 1 and squeezes the axis.
+**/
+/**************************************************************************{{{*/
+static bool
+postop_topk(PostOpBlob& blob, int axis, size_t k, bool squeeze)
+{
+    if ((axis = blob.axis(axis)) < 0) { return false; }
+
+    size_t outer, n, inner;
+    blob.split(axis, outer, n, inner);
+    k = std::min(k, n);
+
+    std::vector<float> value(outer*k*inner);
+    std::vector<int>   index(outer*k*inner);
+    std::vector<int>   order(n);
+
+    for (size_t o = 0; o < outer; o++) {
+        for (size_t i = 0; i < inner; i++) {
+            const float* src = blob.mValue.data() + o*n*inner + i;
+            auto greater = [src, inner](int a, int b) { return src[a*inner] > src[b*inner]; };
+
+            std::iota(order.begin(), order.end(), 0);
+            if (k == 1) {
+                order[0] = *std::max_element(order.begin(), order.end(), [&](int a, int b) { return greater(b, a); });
+            }
+            else {
+                std::partial_sort(order.begin(), order.begin() + k, order.end(), greater);
+            }
+
+            for (size_t j = 0; j < k; j++) {
+                size_t dst = (o*k + j)*inner + i;
+                value[dst] = src[order[j]*inner];
+                index[dst] = blob.mIndex.empty() ? order[j] : blob.mIndex[o*n*inner + order[j]*inner + i];
+            }
+        }
+    }
+
+    blob.mValue.swap(value);
+    blob.mIndex.swap(index);
+    if (squeeze) {
+        blob.mShape.erase(blob.mShape.begin() + axis);
+    }
+    else {
+        blob.mShape[axis] = static_cast<int>(k);
+    }
+
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* threshold compaction
+* @par DESCRIPTION
+*   keep the elements greater than the threshold. the result is flattened,
+*   and the index holds the flat position (or the index made by prior ops).
+**/
+/**************************************************************************{{{*/
+static bool
+postop_threshold(PostOpBlob& blob, float threshold)
+{
+    std::vector<float> value;
+    std::vector<int>   index;
+
+    for (size_t i = 0, n = blob.mValue.size(); i < n; i++) {
+        if (blob.mValue[i] > threshold) {
+            value.push_back(blob.mValue[i]);
+            index.push_back(blob.mIndex.empty() ? static_cast<int>(i) : blob.mIndex[i]);
+        }
+    }
+
+    blob.mValue.swap(value);
+    blob.mIndex.swap(index);
+    blob.mShape.assign(1, static_cast<int>(blob.mValue.size()));
+
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* cast the result to the binary
+* @par DESCRIPTION
+*   put out the index if the chain has made it, otherwise the value.
+**/
+/**************************************************************************{{{*/
+template <class T>
+static std::string
+cast_to(const PostOpBlob& blob)
+{
+    size_t n = blob.mValue.size();
+    std::string res(n*sizeof(T), '\0');
+    T* dst = reinterpret_cast<T*>(&res[0]);
+
+    if (blob.mIndex.empty()) {
+        for (size_t i = 0; i < n; i++) { dst[i] = static_cast<T>(blob.mValue[i]); }
+    }
+    else {
+        for (size_t i = 0; i < n; i++) { dst[i] = static_cast<T>(blob.mIndex[i]); }
+    }
+    return res;
+}
+
+static std::string
+postop_cast(const PostOpBlob& blob, int dtype)
+{
+    switch (dtype) {
+    case TensorSpec::DTYPE_F32: return cast_to<float>(blob);
+    case TensorSpec::DTYPE_U8:  return cast_to<uint8_t>(blob);
+    case TensorSpec::DTYPE_I8:  return cast_to<int8_t>(blob);
+    case TensorSpec::DTYPE_U16: return cast_to<uint16_t>(blob);
+    case TensorSpec::DTYPE_I16: return cast_to<int16_t>(blob);
+    case TensorSpec::DTYPE_I32: return cast_to<int32_t>(blob);
+    default:                    return std::string("");
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* post-op chain on the output tensor
+* @par DESCRIPTION
+*   run softmax/sigmoid/argmax/top-k/threshold/cast over the output tensor
+*   and return only the reduced result.
+*
+* @retval json   {"shape":[..], "value":[..], "index":[..], "label":[..]}
+* @retval binary result of the cast op
+**/
+/**************************************************************************{{{*/
+std::string
+postop(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Op {
+        unsigned int code;
+        int          axis;
+        float        param;
+    });
+    PACK(
+    struct Prms {
+        unsigned int index;
+        unsigned int count;
+        Op           ops[1];
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    // error result: an empty binary if the chain ends with cast, otherwise json
+    bool to_bin = false;
+    for (unsigned int i = 0; i < prms->count; i++) {
+        to_bin |= (prms->ops[i].code == POSTOP_CAST);
+    }
+    auto error = [to_bin](int status) {
+        json res;
+        res["status"] = status;
+        return to_bin ? std::string("") : res.dump();
+    };
+
+    TensorView view;
+    if (prms->index >= sys.mInterp->OutputCount()
+    || !sys.mInterp->get_output_view(prms->index, view)) {
+        return error(-1);
+    }
+
+    sys.start_watch();
+
+    PostOpBlob blob;
+    blob.mShape = view.mShape;
+    blob.mValue = view.to_float();
+
+    for (unsigned int i = 0; i < prms->count; i++) {
+        const Op& op = prms->ops[i];
+        bool ok;
+
+        switch (op.code) {
+        case POSTOP_SOFTMAX:   ok = postop_softmax(blob, op.axis); break;
+        case POSTOP_SIGMOID:   ok = postop_sigmoid(blob); break;
+        case POSTOP_ARGMAX:    ok = postop_topk(blob, op.axis, 1, true); break;
+        case POSTOP_TOPK:
+            {
+            // k < 1 and NaN would wrap in the cast; k over the elements is clamped anyway
+            const double k = op.param;
+            ok = std::isfinite(k) && k >= 1.0
+              && postop_topk(blob, op.axis, static_cast<size_t>(std::min<double>(k, blob.mValue.size())), false);
+            }
+            break;
+        case POSTOP_THRESHOLD: ok = postop_threshold(blob, op.param); break;
+        case POSTOP_CAST:
+            {
+            std::string&& bin = postop_cast(blob, static_cast<int>(op.param));
+            sys.LAP_OUTPUT();
+            return bin;
+            }
+        default:               ok = false; break;
+        }
+
+        if (!ok) {
+            return error(-2);
+        }
+    }
+
+    json res;
+    res["shape"] = blob.mShape;
+    res["value"] = blob.mValue;
+    if (!blob.mIndex.empty()) {
+        res["index"] = blob.mIndex;
+        if (sys.mNumClass > 0) {
+            for (const auto& id : blob.mIndex) {
+                res["label"].push_back(sys.label(id));
+            }
+        }
+    }
+
+    sys.LAP_OUTPUT();
+
+    return res.dump();
+}
+
+/*** postop.cc ************************************************************}}}*/
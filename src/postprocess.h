@@ -14,9 +14,41 @@
 /**************************************************************************}}}**
 * 
 ***************************************************************************{{{*/
+// box selected by NMS: {x1, y1, x2, y2}
+struct Detection {
+    unsigned int mIndex;
+    float        mBBox[4];
+    float        mScore;
+
+    // put out the scaled BBox in JSON formatting
+    json to_json() const {
+        auto result = json::array();
+        result.push_back(mScore);
+        result.push_back(mBBox[0]);
+        result.push_back(mBBox[1]);
+        result.push_back(mBBox[2]);
+        result.push_back(mBBox[3]);
+        result.push_back(mIndex);
+        return result;
+    }
+};
+void non_max_suppression_multi_class(unsigned int num_boxes, unsigned int box_repr, const float* boxes,
+    unsigned int num_class, const float* scores, float iou_threshold, float score_threshold, float sigma,
+    std::function<void(unsigned int class_id, const Detection&)> select);
+
 std::string non_max_suppression_multi_class(SysInfo& sys, const void* args);
+std::string postop(SysInfo& sys, const void* args);
+std::string decode_keypoints(SysInfo& sys, const void* args);
+std::string segment_mask(SysInfo& sys, const void* args);
+std::string qa_span(SysInfo& sys, const void* args);
+std::string encode_image(SysInfo& sys, const void* args);
 
 #define POST_PROCESS \
-    non_max_suppression_multi_class
+    non_max_suppression_multi_class, \
+    postop, \
+    decode_keypoints, \
+    segment_mask, \
+    qa_span, \
+    encode_image
 
 #endif /* _POSTPROCESS_H */
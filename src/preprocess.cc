@@ -0,0 +1,332 @@
+/***  File Header  ************************************************************/
+/**
+* preprocess.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: pre processing
+* @author      Shozo Fukuda
+* @date create Sun Oct 19 16:48:12 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* resampling kernel along one axis
+* @par DESCRIPTION
+*   it holds the source taps and weights of every destination pixel (CSR).
+**/
+/**************************************************************************{{{*/
+class ResampleKernel {
+//LIFECYCLE:
+public:
+    ResampleKernel(int src_offset, int src_len, int dst_len, unsigned int filter) {
+        mStart.reserve(dst_len + 1);
+        mStart.push_back(0);
+
+        const double scale = static_cast<double>(src_len)/dst_len;
+
+        for (int d = 0; d < dst_len; d++) {
+            switch ((filter == 1 && scale <= 1.0) ? 0 : filter) {
+            case 2: // nearest
+                {
+                int i = std::min(src_len-1, static_cast<int>((d + 0.5)*scale));
+                add(src_offset + i, 1.0f);
+                }
+                break;
+
+            case 1: // area
+                {
+                double a = d*scale, b = (d + 1)*scale;
+                for (int i = static_cast<int>(a); i < std::min(src_len, static_cast<int>(std::ceil(b))); i++) {
+                    double overlap = std::min<double>(b, i + 1) - std::max<double>(a, i);
+                    if (overlap > 0.0) {
+                        add(src_offset + i, static_cast<float>(overlap/scale));
+                    }
+                }
+                }
+                break;
+
+            case 0: // bilinear
+            default:
+                {
+                double s = std::min<double>(std::max((d + 0.5)*scale - 0.5, 0.0), src_len - 1);
+                int    i0 = static_cast<int>(s);
+                int    i1 = std::min(i0 + 1, src_len - 1);
+                float  w  = static_cast<float>(s - i0);
+                add(src_offset + i0, 1.0f - w);
+                if (i1 != i0 && w > 0.0f) {
+                    add(src_offset + i1, w);
+                }
+                }
+                break;
+            }
+            mStart.push_back(static_cast<int>(mIndex.size()));
+        }
+    }
+
+//INQUIRY:
+public:
+    int begin(int d) const { return mStart[d];   }
+    int end(int d)   const { return mStart[d+1]; }
+
+//ATTRIBUTE:
+public:
+    std::vector<int>   mStart;
+    std::vector<int>   mIndex;
+    std::vector<float> mWeight;
+
+private:
+    void add(int index, float weight) {
+        mIndex.push_back(index);
+        mWeight.push_back(weight);
+    }
+};
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* store the row of pixels into the tensor
+* @par DESCRIPTION
+*   normalize the pixels (x - mean)/std and quantize them if needed.
+**/
+/**************************************************************************{{{*/
+template <class T>
+static void
+store_row(TensorView& tensor, size_t offset, size_t plane, const float* row, int width, int channel, const float* mean, const float* inv_std)
+{
+    T* dst = reinterpret_cast<T*>(tensor.mData) + offset;
+
+    const bool  quant = std::is_integral<T>::value;
+    const float scale = (tensor.mScale != 0.0f) ? 1.0f/tensor.mScale : 1.0f;
+    const float zero  = (tensor.mScale != 0.0f) ? static_cast<float>(tensor.mZeroPoint) : 0.0f;
+    const float lo    = static_cast<float>(std::numeric_limits<T>::lowest());
+    const float hi    = static_cast<float>(std::numeric_limits<T>::max());
+
+    for (int c = 0; c < channel; c++) {
+        const float m = mean[c], s = inv_std[c];
+        const float* src = row + c;
+        T* d = dst + ((plane > 0) ? c*plane : c);
+        const size_t step = (plane > 0) ? 1 : channel;
+
+        if (quant) {
+            for (int x = 0; x < width; x++, src += channel, d += step) {
+                float v = std::round((*src - m)*s*scale + zero);
+                *d = static_cast<T>(std::min(std::max(v, lo), hi));
+            }
+        }
+        else {
+            for (int x = 0; x < width; x++, src += channel, d += step) {
+                *d = static_cast<T>((*src - m)*s);
+            }
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* crop region of the normalized box
+* @par DESCRIPTION
+*   the box {x0, y0, x1, y1} (0..1) is mapped to the pixels of the frame and
+*   grown to 1px at least, so that a degenerate box still crops its spot
+*   instead of meaning the whole frame.
+**/
+/**************************************************************************{{{*/
+void
+box_to_roi(const float box[4], const ImageFrame& frame, ImageOpts& opts)
+{
+    // ImageOpts is packed: no pointer into opts.roi
+    const int W = frame.mWidth, H = frame.mHeight;
+    const int x0 = std::min(std::max(static_cast<int>(box[0]*W), 0), W - 1);
+    const int y0 = std::min(std::max(static_cast<int>(box[1]*H), 0), H - 1);
+    opts.roi[0] = x0;
+    opts.roi[1] = y0;
+    opts.roi[2] = std::max(x0 + 1, std::min(static_cast<int>(box[2]*W + 0.5f), W));
+    opts.roi[3] = std::max(y0 + 1, std::min(static_cast<int>(box[3]*H + 0.5f), H));
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* put the image frame into the input tensor
+* @par DESCRIPTION
+*   crop, resize (bilinear/area/nearest), letterbox and normalize the frame
+*   straight into the slot "batch" of the input tensor. the resampling is
+*   separable: each source row is resampled horizontally once, then blended
+*   vertically. the inner loops run over contiguous floats.
+*
+* @retval 0  success
+* @retval <0 error
+**/
+/**************************************************************************{{{*/
+int
+image_to_tensor(const ImageFrame& frame, const ImageOpts& opts, TensorView& tensor, size_t batch, float aspect[2])
+{
+    // geometry of the input tensor
+    std::vector<int> shape(tensor.mShape);
+    if (shape.size() == 3) {
+        shape.insert(shape.begin(), 1);
+    }
+    if (shape.size() != 4 || batch >= static_cast<size_t>(shape[0])) {
+        return -1;
+    }
+    const int H = opts.nchw ? shape[2] : shape[1];
+    const int W = opts.nchw ? shape[3] : shape[2];
+    const int C = opts.nchw ? shape[1] : shape[3];
+    if (C > 4) {
+        return -1;
+    }
+
+    // crop region
+    int x0 = 0, y0 = 0, x1 = frame.mWidth, y1 = frame.mHeight;
+    if (opts.roi[2] > opts.roi[0] && opts.roi[3] > opts.roi[1]) {
+        x0 = std::max(0, opts.roi[0]);  x1 = std::min(frame.mWidth,  opts.roi[2]);
+        y0 = std::max(0, opts.roi[1]);  y1 = std::min(frame.mHeight, opts.roi[3]);
+    }
+    const int sw = x1 - x0, sh = y1 - y0;
+    if (sw <= 0 || sh <= 0) {
+        return -2;
+    }
+
+    // size of the resized image in the tensor
+    int dw = W, dh = H;
+    if (opts.fit == 1) {
+        double r = std::min(static_cast<double>(W)/sw, static_cast<double>(H)/sh);
+        dw = std::max(1, std::min(W, static_cast<int>(std::lround(sw*r))));
+        dh = std::max(1, std::min(H, static_cast<int>(std::lround(sh*r))));
+    }
+    aspect[0] = static_cast<float>(dw)/W;
+    aspect[1] = static_cast<float>(dh)/H;
+
+    // source channel of each tensor channel
+    const int Cs = frame.mChannel;
+    int src_ch[4];
+    for (int c = 0; c < C; c++) {
+        int k = (opts.bgr && c < 3 && Cs >= 3) ? 2 - c : c;
+        src_ch[c] = (Cs == 1) ? ((c < 3) ? 0 : -1) : ((k < Cs) ? k : -1);
+    }
+
+    float mean[4], inv_std[4];
+    for (int c = 0; c < C; c++) {
+        mean[c]    = opts.mean[c];
+        inv_std[c] = (opts.std[c] != 0.0f) ? 1.0f/opts.std[c] : 1.0f;
+    }
+
+    ResampleKernel kx(x0, sw, dw, opts.filter);
+    ResampleKernel ky(y0, sh, dh, opts.filter);
+
+    // horizontally resampled rows, made on demand
+    const size_t rlen = static_cast<size_t>(dw)*C;
+    std::vector<float> hrows(static_cast<size_t>(sh)*rlen);
+    std::vector<bool>  ready(sh, false);
+    auto hrow = [&](int sy) -> const float* {
+        float* dst = hrows.data() + (sy - y0)*rlen;
+        if (!ready[sy - y0]) {
+            const uint8_t* src = frame.mData + static_cast<size_t>(sy)*frame.mWidth*Cs;
+            for (int x = 0; x < dw; x++) {
+                float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for (int t = kx.begin(x); t < kx.end(x); t++) {
+                    const uint8_t* p = src + kx.mIndex[t]*Cs;
+                    const float    w = kx.mWeight[t];
+                    for (int c = 0; c < C; c++) {
+                        acc[c] += (src_ch[c] >= 0) ? w*p[src_ch[c]] : 0.0f;
+                    }
+                }
+                for (int c = 0; c < C; c++) { dst[x*C + c] = acc[c]; }
+            }
+            ready[sy - y0] = true;
+        }
+        return dst;
+    };
+
+    const size_t plane  = opts.nchw ? static_cast<size_t>(H)*W : 0;
+    const size_t offset = batch*static_cast<size_t>(H)*W*C;
+    std::vector<float> row(static_cast<size_t>(W)*C);
+
+    for (int y = 0; y < H; y++) {
+        std::fill(row.begin(), row.end(), opts.pad);
+
+        if (y < dh) {
+            std::fill(row.begin(), row.begin() + rlen, 0.0f);
+            for (int t = ky.begin(y); t < ky.end(y); t++) {
+                const float* src = hrow(ky.mIndex[t]);
+                const float  w   = ky.mWeight[t];
+                float* dst = row.data();
+                for (size_t i = 0; i < rlen; i++) { dst[i] += w*src[i]; }
+            }
+        }
+
+        size_t pos = offset + (opts.nchw ? static_cast<size_t>(y)*W : static_cast<size_t>(y)*W*C);
+        switch (tensor.mDType) {
+        case TensorSpec::DTYPE_F32: store_row<float>(tensor, pos, plane, row.data(), W, C, mean, inv_std);   break;
+        case TensorSpec::DTYPE_U8:  store_row<uint8_t>(tensor, pos, plane, row.data(), W, C, mean, inv_std); break;
+        case TensorSpec::DTYPE_I8:  store_row<int8_t>(tensor, pos, plane, row.data(), W, C, mean, inv_std);  break;
+        default:
+            return -3;
+        }
+    }
+
+    return 0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* set the image frame to the input tensor
+* @par DESCRIPTION
+*   resize/letterbox/normalize the raw HWC u8 frame into the input tensor.
+*
+* @retval json  {"status": 0, "aspect": [rx, ry]}
+**/
+/**************************************************************************{{{*/
+std::string
+set_input_image(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int index;
+        ImageOpts    opts;
+        unsigned int width;
+        unsigned int height;
+        unsigned int channel;
+        unsigned int size;
+        uint8_t      data[1];
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    TensorView tensor;
+    if (static_cast<size_t>(prms->width)*prms->height*prms->channel != prms->size) {
+        res["status"] = -2;
+        return res.dump();
+    }
+    if (prms->index >= sys.mInterp->InputCount()
+    || !sys.mInterp->get_input_view(prms->index, tensor)) {
+        res["status"] = -1;
+        return res.dump();
+    }
+
+    sys.start_watch();
+
+    ImageFrame frame = {
+        static_cast<int>(prms->width), static_cast<int>(prms->height), static_cast<int>(prms->channel), prms->data
+    };
+    float aspect[2];
+    int status = image_to_tensor(frame, prms->opts, tensor, 0, aspect);
+
+    res["status"] = status;
+    if (status == 0) {
+        res["aspect"] = { aspect[0], aspect[1] };
+    }
+
+    sys.LAP_INPUT();
+
+    return res.dump();
+}
+
+/*** preprocess.cc ********************************************************}}}*/
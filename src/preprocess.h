@@ -0,0 +1,66 @@
+/***  File Header  ************************************************************/
+/**
+* preprocess.h
+*
+* system setting - used throughout the system
+* @author      Shozo Fukuda
+* @date create Sun Oct 19 16:48:12 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+*******************************************************************************/
+#ifndef _PREPROCESS_H
+#define _PREPROCESS_H
+
+/**************************************************************************}}}**
+* image to input tensor
+***************************************************************************{{{*/
+// raw image frame: HWC u8
+struct ImageFrame {
+    int            mWidth;
+    int            mHeight;
+    int            mChannel;
+    const uint8_t* mData;
+};
+
+// how to put the frame into the input tensor
+PACK(
+struct ImageOpts {
+    int          roi[4];        // crop {x0, y0, x1, y1} in the frame. x1 <= x0: whole frame
+    unsigned int fit;           // 0: stretch, 1: letterbox (top-left aligned)
+    unsigned int filter;        // 0: bilinear, 1: area, 2: nearest
+    unsigned int nchw;          // layout of the input tensor
+    unsigned int bgr;           // swap R and B
+    float        pad;           // pixel value of the letterbox padding
+    float        mean[4];       // normalization: (x - mean)/std
+    float        std[4];
+});
+
+int image_to_tensor(const ImageFrame& frame, const ImageOpts& opts, TensorView& tensor, size_t batch, float aspect[2]);
+void box_to_roi(const float box[4], const ImageFrame& frame, ImageOpts& opts);
+bool decode_image(const uint8_t* data, size_t size, std::vector<uint8_t>& pixels, ImageFrame& frame);
+const ImageFrame* find_frame(unsigned int handle);
+
+std::string set_input_image(SysInfo& sys, const void* args);
+std::string set_input_encoded_image(SysInfo& sys, const void* args);
+std::string put_frame(SysInfo& sys, const void* args);
+std::string drop_frame(SysInfo& sys, const void* args);
+std::string run_rois(SysInfo& sys, const void* args);
+
+#define PRE_PROCESS \
+    set_input_image, \
+    set_input_encoded_image, \
+    put_frame, \
+    drop_frame, \
+    run_rois
+
+/**************************************************************************}}}**
+* audio to input tensor
+***************************************************************************{{{*/
+std::string put_audio(SysInfo& sys, const void* args);
+std::string drop_audio(SysInfo& sys, const void* args);
+
+#define AUDIO_FRONTEND \
+    put_audio, \
+    drop_audio
+
+#endif /* _PREPROCESS_H */
@@ -0,0 +1,122 @@
+/***  File Header  ************************************************************/
+/**
+* qaspan.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: post processing
+* @author      Shozo Fukuda
+* @date create Sun Oct 19 11:21:14 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "postprocess.h"
+
+#include <algorithm>
+#include <queue>
+#include <cstddef>
+
+/***  Type ****************************************************************}}}*/
+/**
+* answer span candidate
+**/
+/**************************************************************************{{{*/
+struct Span {
+    float mScore;
+    int   mBeg;
+    int   mEnd;
+
+    // Comparison operation: the min-heap keeps the best N spans
+    bool operator< (const Span& x) const {
+        return mScore > x.mScore;
+    }
+};
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* Extractive QA span search
+* @par DESCRIPTION
+*   search the best N spans {beg <= end, end - beg + 1 <= max_len} maximizing
+*   start_logits[beg] + end_logits[end] over the tokens mapped to the context
+*   words. it sweeps every end token with the window of max_len, so the search
+*   is exact and costs O(seq_len * max_len).
+*
+* @retval json  [[beg_word, end_word, score, beg_token, end_token], ..]
+**/
+/**************************************************************************{{{*/
+std::string
+qa_span(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int start_index;   // output tensor of start logits
+        unsigned int end_index;     // output tensor of end logits
+        unsigned int max_len;       // max answer length in tokens
+        unsigned int num_best;      // number of spans to return
+        unsigned int count;         // length of the token-to-word map
+        int          map[1];        // token-to-word map, -1 = not a context word
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    TensorView vbeg, vend;
+    if (prms->start_index >= sys.mInterp->OutputCount()
+    ||  prms->end_index   >= sys.mInterp->OutputCount()
+    || !sys.mInterp->get_output_view(prms->start_index, vbeg)
+    || !sys.mInterp->get_output_view(prms->end_index, vend)) {
+        res["status"] = -1;
+        return res.dump();
+    }
+
+    sys.start_watch();
+
+    std::vector<float>&& beg_logits = vbeg.to_float();
+    std::vector<float>&& end_logits = vend.to_float();
+    const int  seq_len = static_cast<int>(std::min({beg_logits.size(), end_logits.size(), static_cast<size_t>(prms->count)}));
+    const int  max_len = static_cast<int>(prms->max_len);
+
+    // the map in the packed args may be unaligned
+    std::vector<int> map(seq_len);
+    memcpy(map.data(), reinterpret_cast<const uint8_t*>(prms) + offsetof(Prms, map), seq_len*sizeof(int));
+
+    std::priority_queue<Span> best;
+    for (int e = 0; e < seq_len; e++) {
+        if (map[e] < 0) continue;
+
+        for (int b = std::max(0, e - max_len + 1); b <= e; b++) {
+            if (map[b] < 0) continue;
+
+            float score = beg_logits[b] + end_logits[e];
+            if (best.size() < prms->num_best) {
+                best.push({score, b, e});
+            }
+            else if (score > best.top().mScore) {
+                best.pop();
+                best.push({score, b, e});
+            }
+        }
+    }
+
+    // put out in descending order of score
+    std::vector<Span> spans;
+    for (; !best.empty(); best.pop()) {
+        spans.push_back(best.top());
+    }
+    res = json::array();
+    for (auto it = spans.rbegin(); it != spans.rend(); ++it) {
+        auto item = json::array();
+        item.push_back(map[it->mBeg]);
+        item.push_back(map[it->mEnd]);
+        item.push_back(it->mScore);
+        item.push_back(it->mBeg);
+        item.push_back(it->mEnd);
+        res.push_back(item);
+    }
+
+    sys.LAP_OUTPUT();
+
+    return res.dump();
+}
+
+/*** qaspan.cc ************************************************************}}}*/
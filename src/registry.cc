@@ -0,0 +1,540 @@
+/***  File Header  ************************************************************/
+/**
+* registry.cc
+*
+* Elixir/Erlang Port ext. of Tiny ML: model registry
+* @author      Shozo Fukuda
+* @date create Tue Oct 21 10:02:37 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "tiny_ml.h"
+#include "registry.h"
+
+/***  Type ****************************************************************}}}*/
+/**
+* registered model
+**/
+/**************************************************************************{{{*/
+enum ModelState {
+    MODEL_READY   = 0,
+    MODEL_LOADING = 1,
+    MODEL_EVICTED = 2,          // unloaded by the memory budget, reloaded on demand
+    MODEL_ERROR   = -1,
+};
+
+static const char* gStateName[] = { "error", "ready", "loading", "evicted" };
+
+struct ModelEntry {
+    std::string                   mModelPath;
+    std::string                   mLabelPath;
+    std::vector<std::string>      mLabel;
+    std::unique_ptr<TinyMLInterp> mInterp;
+    std::shared_future<void>      mLoading;     // valid if loaded in the background
+    std::atomic<int>              mState { MODEL_LOADING };
+    chrono::milliseconds          mLoadTime { 0 };
+
+    // to reload
+    int                           mThread { 0 };
+    int                           mSplit { 1 };
+    int                           mSlot { 1 };
+
+    // residency
+    size_t                        mBytes { 0 };         // estimated memory usage
+    unsigned long                 mLastUsed { 0 };      // LRU clock
+    bool                          mReloaded { false };  // not told the client yet
+    unsigned long                 mEvictions { 0 };
+    unsigned long                 mReloads { 0 };
+    chrono::milliseconds          mReloadTime { 0 };    // total
+};
+
+static std::mutex gMutex;
+static std::map<unsigned int, std::shared_ptr<ModelEntry>> gModels;
+static unsigned long gClock = 0;
+
+static std::shared_ptr<ModelEntry>
+find_model(unsigned int id)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    auto it = gModels.find(id);
+    return (it != gModels.end()) ? it->second : nullptr;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* load the class labels
+* @par DESCRIPTION
+*   one label per line.
+*
+* @retval true  success
+* @retval false can't open the file
+**/
+/**************************************************************************{{{*/
+bool
+load_labels(const std::string& path, std::vector<std::string>& labels)
+{
+    std::string   label;
+    std::ifstream lb_file(path);
+    if (lb_file.fail()) {
+        return false;
+    }
+
+    labels.clear();
+    while (getline(lb_file, label)) {
+        labels.emplace_back(label);
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* register the loaded model
+* @par DESCRIPTION
+*   the registry takes the ownership of "interp".
+*
+* @retval true  success
+* @retval false can't open the labels
+**/
+/**************************************************************************{{{*/
+bool
+add_model(unsigned int id, TinyMLInterp* interp, const std::string& model, const std::string& labels)
+{
+    auto entry = std::make_shared<ModelEntry>();
+    entry->mModelPath = model;
+    entry->mLabelPath = labels;
+    entry->mThread    = gSys.mNumThread;
+    entry->mSplit     = gSys.mNumSplit;
+    entry->mSlot      = gSys.mNumSlot;
+    entry->mInterp.reset(interp);
+    entry->mBytes     = interp->memory_usage();
+    if (labels != "none" && !load_labels(labels, entry->mLabel)) {
+        return false;
+    }
+    entry->mState = MODEL_READY;
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    gModels[id] = entry;
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* update the memory usage of the resident models
+* @par DESCRIPTION
+*   the states of the streams grow after the load. called with gMutex locked.
+**/
+/**************************************************************************{{{*/
+static void
+refresh_usage()
+{
+    for (const auto& item : gModels) {
+        if (item.second->mState == MODEL_READY) {
+            item.second->mBytes = item.second->mInterp->memory_usage();
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* evict the models over the memory budget
+* @par DESCRIPTION
+*   the least recently used models are unloaded (the interpreter and the
+*   model buffer are freed) until the resident models fit in the budget.
+*   the model "keep" and the models holding the state a reload would lose
+*   (pending output, signature, stream states) are not evicted. called with
+*   gMutex locked.
+**/
+/**************************************************************************{{{*/
+static void
+enforce_budget(size_t budget, const ModelEntry* keep)
+{
+    if (budget == 0) {
+        return;
+    }
+
+    size_t used = 0;
+    for (const auto& item : gModels) {
+        if (item.second->mState == MODEL_READY) {
+            used += item.second->mBytes;
+        }
+    }
+
+    while (used > budget) {
+        ModelEntry* victim = nullptr;
+        for (const auto& item : gModels) {
+            ModelEntry* entry = item.second.get();
+            if (entry != keep && entry->mState == MODEL_READY && !entry->mInterp->holds_state()
+            && (victim == nullptr || entry->mLastUsed < victim->mLastUsed)) {
+                victim = entry;
+            }
+        }
+        if (victim == nullptr) {
+            break;
+        }
+
+        victim->mState = MODEL_EVICTED;
+        victim->mInterp.reset();
+        victim->mEvictions++;
+        used -= victim->mBytes;
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* reload the evicted model
+* @par DESCRIPTION
+*
+*
+* @retval true  success
+* @retval false failed to load
+**/
+/**************************************************************************{{{*/
+static bool
+reload_model(ModelEntry* entry)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    std::unique_ptr<TinyMLInterp> interp(create_interp(gSys, entry->mModelPath, entry->mThread, entry->mSplit, entry->mSlot));
+    if (!interp->valid()) {
+        entry->mState = MODEL_ERROR;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    entry->mBytes  = interp->memory_usage();
+    entry->mInterp = std::move(interp);
+    entry->mState  = MODEL_READY;
+    entry->mReloaded = true;
+    entry->mReloads++;
+    entry->mReloadTime += chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* select the model to serve the request
+* @par DESCRIPTION
+*   the model loading in the background is not waited for, so the requests
+*   to the other models keep going. it reloads the model evicted by the
+*   memory budget. the first request after the reload fails with
+*   REQ_RELOADED, since the inputs and the outputs set by the previous
+*   requests are lost. "stateless" requests (setting all inputs by
+*   themselves) don't care and keep it for the next one.
+*
+* @retval 0            success
+* @retval REQ_LOADING  the model is loading
+* @retval REQ_RELOADED the model is reloaded, selected but the state is lost
+* @retval REQ_NO_MODEL no model or failed to load
+**/
+/**************************************************************************{{{*/
+int
+select_model(SysInfo& sys, unsigned int id, bool stateless)
+{
+    auto entry = find_model(id);
+    if (!entry) {
+        return REQ_NO_MODEL;
+    }
+    if (entry->mState == MODEL_LOADING) {
+        return REQ_LOADING;
+    }
+    if (entry->mState == MODEL_EVICTED && !reload_model(entry.get())) {
+        return REQ_NO_MODEL;
+    }
+    if (entry->mState != MODEL_READY) {
+        return REQ_NO_MODEL;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        entry->mLastUsed = ++gClock;
+        refresh_usage();
+        enforce_budget(sys.mMemBudget, entry.get());
+    }
+
+    sys.mInterp    = entry->mInterp.get();
+    sys.mLabel     = &entry->mLabel;
+    sys.mNumClass  = entry->mLabel.size();
+    sys.mModelPath = entry->mModelPath;
+    sys.mLabelPath = entry->mLabelPath;
+
+    if (entry->mReloaded && !stateless) {
+        entry->mReloaded = false;
+        return REQ_RELOADED;
+    }
+    return 0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* make another interpreter of the model
+* @par DESCRIPTION
+*   for the user running the model on its own thread. the caller owns it,
+*   and it is out of the memory budget. thread = 0: the setting of the model.
+*
+* @retval interpreter, nullptr if no model or failed to load
+**/
+/**************************************************************************{{{*/
+TinyMLInterp*
+clone_model(unsigned int id, int thread)
+{
+    auto entry = find_model(id);
+    if (!entry) {
+        return nullptr;
+    }
+    if (entry->mLoading.valid()) {
+        entry->mLoading.wait();
+    }
+    if (entry->mState == MODEL_ERROR) {
+        return nullptr;
+    }
+
+    std::unique_ptr<TinyMLInterp> interp(create_interp(gSys, entry->mModelPath, thread ? thread : entry->mThread, 1, 1));
+    return interp->valid() ? interp.release() : nullptr;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* residency of the models
+* @par DESCRIPTION
+*
+*
+* @retval json  {"budget", "resident", "used", "evictions", "reloads", "reload_time"}
+**/
+/**************************************************************************{{{*/
+void
+models_info(SysInfo& sys, json& res)
+{
+    json memory;
+    memory["budget"] = sys.mMemBudget;
+
+    size_t used = 0;
+    unsigned long evictions = 0, reloads = 0;
+    chrono::milliseconds reload_time(0);
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    refresh_usage();
+    memory["resident"] = json::array();
+    for (const auto& item : gModels) {
+        const ModelEntry& entry = *item.second;
+        if (entry.mState == MODEL_READY) {
+            memory["resident"].push_back(item.first);
+            used += entry.mBytes;
+        }
+        evictions   += entry.mEvictions;
+        reloads     += entry.mReloads;
+        reload_time += entry.mReloadTime;
+    }
+    memory["used"]        = used;
+    memory["evictions"]   = evictions;
+    memory["reloads"]     = reloads;
+    memory["reload_time"] = (reloads > 0) ? reload_time.count()/reloads : 0;   // average msec
+
+    res["memory"] = memory;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* cancel the running request
+* @par DESCRIPTION
+*   the request runs on one of the models. called from the receiver thread.
+**/
+/**************************************************************************{{{*/
+void
+cancel_models(uint32_t tag)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    for (auto& item : gModels) {
+        if (item.second->mState == MODEL_READY) {
+            item.second->mInterp->cancel(tag);
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* unload all models
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+void
+clear_models()
+{
+    std::map<unsigned int, std::shared_ptr<ModelEntry>> models;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        models.swap(gModels);
+    }
+    for (auto& item : models) {
+        if (item.second->mLoading.valid()) {
+            item.second->mLoading.wait();
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* load the model
+* @par DESCRIPTION
+*   the model is loaded on the background thread, and the requests to it
+*   are replied REQ_LOADING until the end of loading. the models load in
+*   parallel.
+*   thread/split/slot = 0: the setting of the process.
+*
+* @retval json  {"status": 0, "state": "loading"|"ready"|"error"}
+**/
+/**************************************************************************{{{*/
+std::string
+load_model(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int id;
+        unsigned int wait;          // 1: reply after loading
+        unsigned int thread;
+        unsigned int split;
+        unsigned int slot;
+        unsigned int model_len;
+        unsigned int label_len;
+        char         data[1];       // model path, label path
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    auto entry = std::make_shared<ModelEntry>();
+    entry->mModelPath.assign(prms->data, prms->model_len);
+    entry->mLabelPath.assign(prms->data + prms->model_len, prms->label_len);
+    if (entry->mLabelPath.empty()) {
+        entry->mLabelPath = "none";
+    }
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        if (gModels.count(prms->id) > 0) {
+            res["status"] = -1;
+            return res.dump();
+        }
+        gModels[prms->id] = entry;
+    }
+
+    int thread = prms->thread ? prms->thread : sys.mNumThread;
+    int split  = prms->split  ? prms->split  : sys.mNumSplit;
+    int slot   = prms->slot   ? prms->slot   : sys.mNumSlot;
+
+    // the entry outlives the loader: unload waits for the end of loading
+    entry->mThread = thread;
+    entry->mSplit  = split;
+    entry->mSlot   = slot;
+
+    ModelEntry* loading = entry.get();
+    entry->mLoading = std::async(std::launch::async, [loading, thread, split, slot]() {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        std::unique_ptr<TinyMLInterp> interp(create_interp(gSys, loading->mModelPath, thread, split, slot));
+        bool ok = interp->valid()
+               && (loading->mLabelPath == "none" || load_labels(loading->mLabelPath, loading->mLabel));
+        if (ok) {
+            loading->mBytes  = interp->memory_usage();
+            loading->mInterp = std::move(interp);
+        }
+
+        loading->mLoadTime = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+        loading->mState = ok ? MODEL_READY : MODEL_ERROR;
+    }).share();
+
+    if (prms->wait) {
+        entry->mLoading.wait();
+    }
+
+    res["status"] = (entry->mState == MODEL_ERROR) ? -2 : 0;
+    res["state"]  = gStateName[entry->mState + 1];
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* unload the model
+* @par DESCRIPTION
+*   the model in loading is unloaded after the end of loading.
+*
+* @retval json  {"status": 0}
+**/
+/**************************************************************************{{{*/
+std::string
+unload_model(SysInfo& sys, const void* args)
+{
+    struct Prms {
+        unsigned int id;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    std::shared_ptr<ModelEntry> entry;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        auto it = gModels.find(prms->id);
+        if (it == gModels.end()) {
+            res["status"] = -1;
+            return res.dump();
+        }
+        entry = it->second;
+        gModels.erase(it);
+    }
+    if (entry->mLoading.valid()) {
+        entry->mLoading.wait();
+    }
+
+    if (sys.mInterp == entry->mInterp.get()) {
+        sys.mInterp = nullptr;
+        sys.mLabel  = nullptr;
+    }
+
+    res["status"] = 0;
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* list the models
+* @par DESCRIPTION
+*
+*
+* @retval json  [{"id": id, "model": path, "label": path, "state": state, "load_time": msec,
+*                  "memory": bytes, "evictions": n, "reloads": n}..]
+**/
+/**************************************************************************{{{*/
+std::string
+list_models(SysInfo&, const void*)
+{
+    json res = json::array();
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    refresh_usage();
+    for (const auto& item : gModels) {
+        const ModelEntry& entry = *item.second;
+        json model;
+        model["id"]    = item.first;
+        model["model"] = entry.mModelPath;
+        model["label"] = entry.mLabelPath;
+        model["state"] = gStateName[entry.mState + 1];
+        if (entry.mState != MODEL_LOADING) {
+            model["load_time"] = entry.mLoadTime.count();
+            model["memory"]    = entry.mBytes;
+            model["evictions"] = entry.mEvictions;
+            model["reloads"]   = entry.mReloads;
+        }
+        res.push_back(model);
+    }
+
+    return res.dump();
+}
+
+/*** registry.cc **********************************************************}}}*/
@@ -0,0 +1,44 @@
+/***  File Header  ************************************************************/
+/**
+* registry.h
+*
+* model registry - multiple models in one process
+* @author      Shozo Fukuda
+* @date create Tue Oct 21 10:02:37 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+*******************************************************************************/
+#ifndef _REGISTRY_H
+#define _REGISTRY_H
+
+/**************************************************************************}}}**
+* model registry
+***************************************************************************{{{*/
+// status of the request to the model not ready
+enum {
+    REQ_NO_MODEL = -16,         // unknown or failed to load
+    REQ_LOADING  = -17,         // still loading in the background, retry later
+    REQ_RELOADED = -18,         // reloaded after the eviction, the state of the model is lost
+};
+
+bool load_labels(const std::string& path, std::vector<std::string>& labels);
+bool add_model(unsigned int id, TinyMLInterp* interp, const std::string& model, const std::string& labels);
+int select_model(SysInfo& sys, unsigned int id, bool stateless=false);
+TinyMLInterp* clone_model(unsigned int id, int thread);
+void cancel_models(uint32_t tag);
+void models_info(SysInfo& sys, json& res);
+void clear_models();
+
+std::string load_model(SysInfo& sys, const void* args);
+std::string unload_model(SysInfo& sys, const void* args);
+std::string list_models(SysInfo& sys, const void* args);
+
+#define MODEL_REGISTRY \
+    load_model, \
+    unload_model, \
+    list_models
+
+// the commands which don't need the selected model
+#define IS_REGISTRY_CMD(f) ((f) == load_model || (f) == unload_model || (f) == list_models)
+
+#endif /* _REGISTRY_H */
@@ -0,0 +1,241 @@
+/***  File Header  ************************************************************/
+/**
+* request_queue.h
+*
+* request queue between the receiver and the interpreter
+* @author      Shozo Fukuda
+* @date create Mon Oct 20 13:26:44 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+*******************************************************************************/
+#ifndef _REQUEST_QUEUE_H
+#define _REQUEST_QUEUE_H
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <map>
+#include <algorithm>
+
+/***  Type ****************************************************************}}}*/
+/**
+* request: command packet with its envelope
+**/
+/**************************************************************************{{{*/
+struct Request {
+    uint32_t    mTag;           // id to match the reply
+    uint32_t    mStream;        // stream id, 0 = not in any stream
+    uint16_t    mPriority;      // priority class, the larger is served first
+    uint16_t    mTenant;        // source of the request for the fair share
+    uint32_t    mModel;         // model id to serve the request
+    double      mFinish;        // virtual finish time of the fair share (set by the queue)
+    std::string mCmdLine;       // <<cmd::32, args::binary>>
+    std::chrono::steady_clock::time_point mDeadline;    // epoch = no deadline
+
+    bool expired(std::chrono::steady_clock::time_point now) const {
+        return mDeadline != std::chrono::steady_clock::time_point() && now > mDeadline;
+    }
+};
+
+// admission policy of the bounded queue
+enum QueuePolicy {
+    QUEUE_REJECT = 0,       // reject the new request when full
+    QUEUE_DROP_OLDEST,      // drop the oldest waiting request when full
+    QUEUE_LATEST,           // keep only the latest request per stream, drop oldest when full
+};
+
+// status of the request not executed
+enum {
+    REQ_DROPPED  = -14,
+    REQ_REJECTED = -15,
+};
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* request queue
+* @par DESCRIPTION
+*   queue of the requests. the receiver thread pushes, the interpreter thread
+*   pops. the requests can be cancelled while they are waiting.
+*   the higher priority class is served strictly first. in the same class,
+*   the tenants share the interpreter by their weights (self-clocked fair
+*   queueing: the request of the smallest virtual finish time goes first).
+*   the queue is bounded by "depth" (0 = unbounded) and the policy decides
+*   which request gives way under overload. the lower priority class always
+*   gives way to the higher one.
+**/
+/**************************************************************************{{{*/
+class RequestQueue {
+//LIFECYCLE:
+public:
+    RequestQueue(size_t depth=0, int policy=QUEUE_REJECT) : mDepth(depth), mPolicy(policy) {}
+
+//ACTION:
+public:
+    // put the request. the requests given way are notified to "drop".
+    // return false if the request is rejected
+    bool push(Request&& req, std::function<void(const Request&)> drop) {
+        std::deque<Request> dropped;
+        bool admitted = true;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            // the newer frame of the stream supersedes the waiting one
+            if (mPolicy == QUEUE_LATEST && req.mStream != 0) {
+                for (auto it = mQueue.begin(); it != mQueue.end();) {
+                    if (it->mStream == req.mStream) {
+                        dropped.push_back(std::move(*it));
+                        it = mQueue.erase(it);
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+            }
+
+            if (mDepth > 0 && mQueue.size() >= mDepth) {
+                // the oldest of the lowest priority class
+                auto victim = mQueue.begin();
+                for (auto it = mQueue.begin(); it != mQueue.end(); ++it) {
+                    if (it->mPriority < victim->mPriority) { victim = it; }
+                }
+                if (victim->mPriority > req.mPriority
+                || (victim->mPriority == req.mPriority && mPolicy == QUEUE_REJECT)) {
+                    admitted = false;
+                }
+                else {
+                    dropped.push_back(std::move(*victim));
+                    mQueue.erase(victim);
+                }
+            }
+
+            if (admitted) {
+                double& last = mLastFinish[req.mTenant];
+                last = std::max(mVirtual, last) + 1.0/weight(req.mTenant);
+                req.mFinish = last;
+                mQueue.push_back(std::move(req));
+            }
+            else {
+                mRejected++;
+            }
+            mDropped += dropped.size();
+        }
+        if (admitted) {
+            mCond.notify_one();
+        }
+
+        for (const auto& item : dropped) {
+            drop(item);
+        }
+        return admitted;
+    }
+
+    // take the next request. return false if the queue is closed and empty
+    bool pop(Request& req) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCond.wait(lock, [this]{ return !mQueue.empty() || mClosed; });
+        if (mQueue.empty()) {
+            return false;
+        }
+        // the highest priority, then the earliest virtual finish time
+        auto next = mQueue.begin();
+        for (auto it = mQueue.begin(); it != mQueue.end(); ++it) {
+            if (it->mPriority > next->mPriority
+            || (it->mPriority == next->mPriority && it->mFinish < next->mFinish)) {
+                next = it;
+            }
+        }
+        req = std::move(*next);
+        mQueue.erase(next);
+
+        mVirtual = std::max(mVirtual, req.mFinish);
+        mServed[req.mTenant]++;
+        return true;
+    }
+
+    // set the weight of the tenant's fair share (default 1.0)
+    void set_weight(uint16_t tenant, double weight) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWeight[tenant] = (weight > 0.0) ? weight : 1.0;
+    }
+
+    // remove the waiting request "tag" (or all if "all"), and notify them to "drop"
+    bool cancel(uint32_t tag, bool all, std::function<void(const Request&)> drop) {
+        std::deque<Request> removed;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (auto it = mQueue.begin(); it != mQueue.end();) {
+                if (all || it->mTag == tag) {
+                    removed.push_back(std::move(*it));
+                    it = mQueue.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+        for (const auto& req : removed) {
+            drop(req);
+        }
+        return !removed.empty();
+    }
+
+    // no more requests
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mClosed = true;
+        }
+        mCond.notify_all();
+    }
+
+//INQUIRY:
+public:
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mQueue.size();
+    }
+    size_t depth()    const { return mDepth;    }
+    int    policy()   const { return mPolicy;   }
+    size_t dropped()  const { return mDropped;  }
+    size_t rejected() const { return mRejected; }
+
+    // {tenant: {weight, served}} of the tenants seen so far
+    std::map<uint16_t, std::pair<double, size_t>> tenants() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::map<uint16_t, std::pair<double, size_t>> res;
+        for (const auto& item : mLastFinish) {
+            res[item.first] = { weight(item.first), mServed[item.first] };
+        }
+        return res;
+    }
+
+private:
+    double weight(uint16_t tenant) {
+        auto it = mWeight.find(tenant);
+        return (it != mWeight.end()) ? it->second : 1.0;
+    }
+
+//ATTRIBUTE:
+private:
+    std::mutex              mMutex;
+    std::condition_variable mCond;
+    std::deque<Request>     mQueue;
+    bool                    mClosed { false };
+
+    size_t                  mDepth;
+    int                     mPolicy;
+    std::atomic<size_t>     mDropped  { 0 };
+    std::atomic<size_t>     mRejected { 0 };
+
+    // weighted fair queueing
+    double                      mVirtual { 0.0 };   // virtual time: finish time of the last served
+    std::map<uint16_t, double>  mWeight;
+    std::map<uint16_t, double>  mLastFinish;
+    std::map<uint16_t, size_t>  mServed;
+};
+
+#endif /* _REQUEST_QUEUE_H */
@@ -0,0 +1,205 @@
+/***  File Header  ************************************************************/
+/**
+* segmask.cc
+*
+* Elixir/Erlang Port ext. of tensor flow lite: post processing
+* @author      Shozo Fukuda
+* @date create Sun Oct 19 09:05:47 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+**/
+/**************************************************************************{{{*/
+
+#include "tiny_ml.h"
+#include "postprocess.h"
+
+/***  Type ****************************************************************}}}*/
+/**
+* segmentation mask options
+**/
+/**************************************************************************{{{*/
+enum MaskMode {
+    MASK_ARGMAX = 0,        // class index of the max probability
+    MASK_THRESHOLD,         // 1 if the channel > threshold else 0
+};
+
+enum MaskEncoding {
+    MASK_RAW = 0,           // u8 per pixel
+    MASK_RLE,               // {value::u8, length::u16-little} per run
+    MASK_BITPACK,           // 1 bit per pixel, MSB first (binary mask only)
+};
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* run-length encoding
+* @par DESCRIPTION
+*   runs longer than 65535 are split.
+**/
+/**************************************************************************{{{*/
+static std::string
+encode_rle(const std::vector<uint8_t>& mask)
+{
+    std::string res;
+
+    size_t i = 0, n = mask.size();
+    while (i < n) {
+        uint8_t  value = mask[i];
+        uint16_t run   = 0;
+        while (i < n && mask[i] == value && run < 0xFFFF) {
+            i++; run++;
+        }
+        res.push_back(static_cast<char>(value));
+        res.push_back(static_cast<char>(run & 0xFF));
+        res.push_back(static_cast<char>(run >> 8));
+    }
+
+    return res;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* bit packing
+* @par DESCRIPTION
+*   non-zero pixel is set to 1.
+**/
+/**************************************************************************{{{*/
+static std::string
+encode_bitpack(const std::vector<uint8_t>& mask)
+{
+    std::string res((mask.size() + 7)/8, '\0');
+
+    for (size_t i = 0, n = mask.size(); i < n; i++) {
+        if (mask[i]) {
+            res[i >> 3] |= static_cast<char>(0x80 >> (i & 7));
+        }
+    }
+
+    return res;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* segmentation mask compaction
+* @par DESCRIPTION
+*   make the class-index mask from the probability map and encode it.
+*
+* @retval binary  <<height::32, width::32, payload::binary>>
+* @retval empty   error
+**/
+/**************************************************************************{{{*/
+std::string
+segment_mask(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int index;
+        unsigned int mode;          // MaskMode
+        unsigned int nchw;          // layout: 0 = [1, H, W, C], 1 = [1, C, H, W]
+        unsigned int channel;       // target channel of MASK_THRESHOLD
+        float        threshold;
+        unsigned int encoding;      // MaskEncoding
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    TensorView view;
+    if (prms->index >= sys.mInterp->OutputCount()
+    || !sys.mInterp->get_output_view(prms->index, view)) {
+        return std::string("");
+    }
+
+    // decompose the shape into {H, W, C}
+    std::vector<int> shape(view.mShape);
+    while (shape.size() > 2 && shape.front() == 1) { shape.erase(shape.begin()); }
+    if (shape.size() == 2) {
+        shape.insert(prms->nchw ? shape.begin() : shape.end(), 1);
+    }
+    if (shape.size() != 3) {
+        return std::string("");
+    }
+    const size_t H = prms->nchw ? shape[1] : shape[0];
+    const size_t W = prms->nchw ? shape[2] : shape[1];
+    const size_t C = prms->nchw ? shape[0] : shape[2];
+    const size_t HW = H*W;
+
+    if (prms->mode == MASK_THRESHOLD && prms->channel >= C) {
+        return std::string("");
+    }
+    if (prms->mode == MASK_ARGMAX && C > 256) {
+        // the class index does not fit in u8
+        return std::string("");
+    }
+    if (prms->mode == MASK_ARGMAX && prms->encoding == MASK_BITPACK && C > 2) {
+        // the class index does not fit in 1 bit
+        return std::string("");
+    }
+
+    sys.start_watch();
+
+    std::vector<float>&& prob = view.to_float();
+    std::vector<uint8_t> mask(HW);
+
+    switch (prms->mode) {
+    case MASK_ARGMAX:
+        if (prms->nchw) {
+            // sweep the planes to keep the access contiguous
+            std::vector<float> vmax(prob.begin(), prob.begin() + HW);
+            std::fill(mask.begin(), mask.end(), 0);
+            for (size_t c = 1; c < C; c++) {
+                const float* plane = prob.data() + c*HW;
+                for (size_t i = 0; i < HW; i++) {
+                    if (plane[i] > vmax[i]) {
+                        vmax[i] = plane[i];
+                        mask[i] = static_cast<uint8_t>(c);
+                    }
+                }
+            }
+        }
+        else {
+            const float* p = prob.data();
+            for (size_t i = 0; i < HW; i++, p += C) {
+                size_t best = 0;
+                for (size_t c = 1; c < C; c++) {
+                    if (p[c] > p[best]) { best = c; }
+                }
+                mask[i] = static_cast<uint8_t>(best);
+            }
+        }
+        break;
+
+    case MASK_THRESHOLD:
+        {
+        const float* p     = prob.data() + (prms->nchw ? prms->channel*HW : prms->channel);
+        const size_t step  = prms->nchw ? 1 : C;
+        const float  th    = prms->threshold;
+        for (size_t i = 0; i < HW; i++, p += step) {
+            mask[i] = (*p > th) ? 1 : 0;
+        }
+        }
+        break;
+
+    default:
+        return std::string("");
+    }
+
+    uint32_t header[2] = { static_cast<uint32_t>(H), static_cast<uint32_t>(W) };
+    std::string res(reinterpret_cast<char*>(header), sizeof(header));
+
+    switch (prms->encoding) {
+    case MASK_RLE:
+        res += encode_rle(mask);
+        break;
+    case MASK_BITPACK:
+        res += encode_bitpack(mask);
+        break;
+    case MASK_RAW:
+    default:
+        res += std::string(reinterpret_cast<char*>(mask.data()), mask.size());
+        break;
+    }
+
+    sys.LAP_OUTPUT();
+
+    return res;
+}
+
+/*** segmask.cc ***********************************************************}}}*/
@@ -0,0 +1,94 @@
+/***  File Header  ************************************************************/
+/**
+* state_arena.h
+*
+* arena of the recurrent states of the streams
+* @author      Shozo Fukuda
+* @date create Thu Oct 23 14:05:51 JST 2026
+* System       MINGW64/Windows 10<br>
+*
+*******************************************************************************/
+#ifndef _STATE_ARENA_H
+#define _STATE_ARENA_H
+
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+/***  Class Header  *******************************************************}}}*/
+/**
+* state arena
+* @par DESCRIPTION
+*   snapshots of the variable tensors keyed by the stream id. all snapshots
+*   of a model have the same size, so they are packed in one buffer of fixed
+*   slots, and the slot of the dropped stream is reused by the next one.
+**/
+/**************************************************************************{{{*/
+class StateArena {
+//ACTION:
+public:
+    // the slot of "stream", allocated if it is new
+    uint8_t* acquire(uint32_t stream, size_t size) {
+        if (mSlot.empty() && mFree.empty()) {
+            mSize = size;
+        }
+        if (size != mSize) {
+            return nullptr;
+        }
+
+        auto it = mSlot.find(stream);
+        if (it != mSlot.end()) {
+            return &mArena[it->second];
+        }
+
+        size_t offset;
+        if (!mFree.empty()) {
+            offset = mFree.back();
+            mFree.pop_back();
+        }
+        else {
+            offset = mArena.size();
+            mArena.resize(offset + mSize);
+        }
+        mSlot[stream] = offset;
+        return &mArena[offset];
+    }
+
+    // the slot of "stream", nullptr if none
+    const uint8_t* find(uint32_t stream) const {
+        auto it = mSlot.find(stream);
+        return (it != mSlot.end()) ? &mArena[it->second] : nullptr;
+    }
+
+    bool release(uint32_t stream) {
+        auto it = mSlot.find(stream);
+        if (it == mSlot.end()) {
+            return false;
+        }
+        mFree.push_back(it->second);
+        mSlot.erase(it);
+
+        if (mSlot.empty()) {
+            mArena.clear();
+            mArena.shrink_to_fit();
+            mFree.clear();
+        }
+        return true;
+    }
+
+//INQUIRY:
+public:
+    size_t count() const { return mSlot.size();  }
+    size_t size()  const { return mSize;         }  // bytes per stream
+    size_t bytes() const { return mArena.size(); }  // bytes of the arena
+
+//ATTRIBUTE:
+private:
+    std::vector<uint8_t>         mArena;
+    std::map<uint32_t, size_t>   mSlot;     // stream -> offset
+    std::vector<size_t>          mFree;     // offsets of the released slots
+    size_t                       mSize { 0 };
+};
+
+#endif /* _STATE_ARENA_H */
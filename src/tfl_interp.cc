@@ -11,6 +11,8 @@
 /**************************************************************************{{{*/
 
 #include <stdio.h>
+#include <thread>
+#include <algorithm>
 #include "tfl_interp.h"
 
 #include "tensorflow/lite/kernels/register.h"
@@ -30,7 +32,25 @@ void add_custom_operations(tflite::ops::builtin::BuiltinOpResolver& resolver);
 /**************************************************************************{{{*/
 void init_interp(SysInfo& sys, std::string& tfl_model, std::string& itempl, std::string& otempl)
 {
-    sys.mInterp = new TflInterp(tfl_model, sys.mNumThread);
+    sys.mInterp = create_interp(sys, tfl_model, sys.mNumThread, sys.mNumSplit, sys.mNumSlot);
+    if (!sys.mInterp->valid()) {
+        exit(1);
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* create interpreter
+* @par DESCRIPTION
+*   it is used to load the model at runtime as well. check valid() of the
+*   result.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+TinyMLInterp* create_interp(SysInfo& sys, std::string& tfl_model, int thread, int split, int slot)
+{
+    return new TflInterp(tfl_model, thread, split, slot, sys.mBuckets, sys.mSeqAxis);
 }
 
 /***  Method Header  ******************************************************}}}*/
@@ -40,10 +60,15 @@ void init_interp(SysInfo& sys, std::string& tfl_model, std::string& itempl, std:
 *   construct an instance.
 **/
 /**************************************************************************{{{*/
-TflInterp::TflInterp(std::string tfl_model, int thread)
+TflInterp::TflInterp(std::string tfl_model, int thread, int split, int slot, const std::vector<int>& buckets, int seq_axis)
 {
     // load tensor flow lite model
     mModel = tflite::FlatBufferModel::BuildFromFile(tfl_model.c_str());
+    if (!mModel) {
+        std::cerr << "error: BuildFromFile(" << tfl_model << ")\n";
+        mValid = false;
+        return;
+    }
 
     tflite::ops::builtin::BuiltinOpResolver resolver;
 
@@ -55,13 +80,356 @@ TflInterp::TflInterp(std::string tfl_model, int thread)
     builder.SetNumThreads(thread);
     builder(&mInterpreter);
 
-    if (mInterpreter->AllocateTensors() != kTfLiteOk) {
+    if (!mInterpreter || mInterpreter->AllocateTensors() != kTfLiteOk) {
         std::cerr << "error: AllocateTensors()\n";
-        exit(1);
+        mValid = false;
+        return;
     }
     
     mInputCount  = mInterpreter->inputs().size();
     mOutputCount = mInterpreter->outputs().size();
+
+    // abort Invoke() on the deadline or the cancel request
+    mInterpreter->SetCancellationFunction(this, cancellation);
+
+    if (split > 1) {
+        setup_split(resolver, split, thread);
+    }
+    if (slot > 1) {
+        setup_staging(slot);
+    }
+    if (!buckets.empty()) {
+        setup_buckets(resolver, buckets, seq_axis, thread);
+    }
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* setup bucketing mode
+* @par DESCRIPTION
+*   build the interpreters sharing the FlatBufferModel, each of which has
+*   the sequence inputs resized to the bucket length along "seq_axis". the
+*   sequence inputs are those having the same length as the input 0 on the
+*   axis and no batch before it. the bucket the model can't be resized to
+*   is skipped.
+**/
+/**************************************************************************{{{*/
+void
+TflInterp::setup_buckets(const tflite::OpResolver& resolver, std::vector<int> buckets, int seq_axis, int thread)
+{
+    TfLiteTensor* itensor = mInterpreter->input_tensor(0);
+    if (seq_axis < 0 || itensor->dims->size <= seq_axis) {
+        return;
+    }
+    mSeqAxis = seq_axis;
+    mSeqMax  = itensor->dims->data[seq_axis];
+
+    mSeqInput.assign(mInputCount, false);
+    mSeqLen.assign(mInputCount, mSeqMax);
+    for (size_t i = 0; i < mInputCount; i++) {
+        TfLiteTensor* t = mInterpreter->input_tensor(i);
+        if (t->dims->size <= seq_axis || t->dims->data[seq_axis] != mSeqMax) {
+            continue;
+        }
+        int lead = 1;
+        for (int k = 0; k < seq_axis; k++) { lead *= t->dims->data[k]; }
+        mSeqInput[i] = (lead == 1);
+    }
+
+    std::sort(buckets.begin(), buckets.end());
+    for (int len : buckets) {
+        if (len <= 0 || len >= mSeqMax) {
+            continue;
+        }
+
+        std::unique_ptr<tflite::Interpreter> bucket;
+        tflite::InterpreterBuilder builder(*mModel, resolver);
+        builder.SetNumThreads(thread);
+        builder(&bucket);
+
+        for (size_t i = 0; i < mInputCount; i++) {
+            if (!mSeqInput[i]) continue;
+            TfLiteTensor* t = mInterpreter->input_tensor(i);
+            std::vector<int> dims(t->dims->data, t->dims->data + t->dims->size);
+            dims[seq_axis] = len;
+            bucket->ResizeInputTensor(bucket->inputs()[i], dims);
+        }
+        if (bucket->AllocateTensors() != kTfLiteOk) {
+            std::cerr << "warning: the model can't run at the bucket " << len << "\n";
+            continue;
+        }
+        bucket->SetCancellationFunction(this, cancellation);
+
+        mBucket.push_back(std::move(bucket));
+        mBucketLen.push_back(len);
+    }
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* pick the bucket for the next invoke
+* @par DESCRIPTION
+*   the shortest bucket fitting the longest sequence input.
+**/
+/**************************************************************************{{{*/
+void
+TflInterp::pick_bucket()
+{
+    mActive    = -1;
+    mActiveLen = 0;
+    if (mBucket.empty() || mSignature) {
+        return;
+    }
+
+    for (size_t i = 0; i < mInputCount; i++) {
+        if (mSeqInput[i]) { mActiveLen = std::max(mActiveLen, mSeqLen[i]); }
+    }
+    for (size_t k = 0; k < mBucket.size(); k++) {
+        if (static_cast<size_t>(mBucketLen[k]) >= mActiveLen) {
+            mActive = static_cast<int>(k);
+            break;
+        }
+    }
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* output tensor of the last invoke
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+const TfLiteTensor*
+TflInterp::active_output(unsigned int index)
+{
+    if (mSignature) {
+        return mSignature->output_tensor(mSignature->output_names()[index]);
+    }
+    return (mActive >= 0) ? mBucket[mActive]->output_tensor(index) : mInterpreter->output_tensor(index);
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* bytes of the output without the padding
+* @par DESCRIPTION
+*   the output having the sequence length on the axis is cut to the length
+*   of the input.
+**/
+/**************************************************************************{{{*/
+size_t
+TflInterp::active_bytes(const TfLiteTensor* tensor)
+{
+    const int len = (mActive >= 0) ? mBucketLen[mActive] : mSeqMax;
+    if (mBucket.empty() || mActiveLen == 0
+    ||  tensor->dims->size <= mSeqAxis || tensor->dims->data[mSeqAxis] != len) {
+        return tensor->bytes;
+    }
+    for (int k = 0; k < mSeqAxis; k++) {
+        if (tensor->dims->data[k] != 1) return tensor->bytes;
+    }
+    return tensor->bytes/len*std::min<size_t>(mActiveLen, len);
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* setup staging mode
+* @par DESCRIPTION
+*   allocate "slot" buffers for each input tensor. they are bound to the
+*   input tensor in turn by the custom allocation, so the next input can be
+*   written while Invoke() is running on the current one. the input not
+*   written wholly since the last swap takes over the data of the front slot
+*   (see sync_slot), so the slices and the bindings persist as without it.
+**/
+/**************************************************************************{{{*/
+void
+TflInterp::setup_staging(int slot)
+{
+    const size_t ALIGN = 64;    // kDefaultTensorAlignment
+
+    mSlotMem.resize(mInputCount);
+    mSlot.resize(mInputCount);
+    for (size_t i = 0; i < mInputCount; i++) {
+        const size_t bytes = (mInterpreter->input_tensor(i)->bytes + ALIGN - 1) & ~(ALIGN - 1);
+
+        mSlotMem[i].resize(slot*bytes + ALIGN);
+        uintptr_t base = (reinterpret_cast<uintptr_t>(mSlotMem[i].data()) + ALIGN - 1) & ~(ALIGN - 1);
+        for (int k = 0; k < slot; k++) {
+            mSlot[i].push_back(reinterpret_cast<uint8_t*>(base + k*bytes));
+        }
+    }
+
+    mBack = 0;
+    mFresh.assign(mInputCount, true);
+    if (swap_slots() < 0) {
+        std::cerr << "error: custom allocation of the staging mode\n";
+        mSlot.clear();
+        mSlotMem.clear();
+    }
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* swap the input slots
+* @par DESCRIPTION
+*   bind the back slot to the input tensors and advance the back slot.
+*   the inputs not written since the last swap are taken over first.
+*
+* @retval 0  success
+* @retval <0 error
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::swap_slots()
+{
+    if (mSlot.empty()) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < mInputCount; i++) {
+        sync_slot(i);
+    }
+    for (size_t i = 0; i < mInputCount; i++) {
+        TfLiteCustomAllocation alloc = { mSlot[i][mBack], mInterpreter->input_tensor(i)->bytes };
+        if (mInterpreter->SetCustomAllocationForTensor(mInterpreter->inputs()[i], alloc) != kTfLiteOk) {
+            return ERR_INVOKE;
+        }
+    }
+    if (mInterpreter->AllocateTensors() != kTfLiteOk) {
+        return ERR_INVOKE;
+    }
+
+    mBack = (mBack + 1) % mSlot[0].size();
+    mFresh.assign(mInputCount, false);
+    return 0;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* take over the input of the front slot
+* @par DESCRIPTION
+*   copy the front slot into the back slot, unless the back slot already
+*   has the latest data of the input. it is needed before a partial write.
+**/
+/**************************************************************************{{{*/
+void
+TflInterp::sync_slot(unsigned int index)
+{
+    if (mSlot.empty() || mSignature || mFresh[index]) {
+        return;
+    }
+
+    const size_t n     = mSlot[index].size();
+    const size_t front = (mBack + n - 1) % n;
+    memcpy(mSlot[index][mBack], mSlot[index][front], mInterpreter->input_tensor(index)->bytes);
+    mFresh[index] = true;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* mark the back slot as holding the latest data of the input
+* @par DESCRIPTION
+*   called after a write, so that swap_slots() doesn't take over the front
+*   slot on it. the write is counted for the caches of the input contents.
+**/
+/**************************************************************************{{{*/
+void
+TflInterp::mark_fresh(unsigned int index)
+{
+    count_write(index);
+    if (mSlot.empty() || mSignature) {
+        return;
+    }
+    mFresh[index] = true;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* buffer to write the input tensor
+* @par DESCRIPTION
+*   the back slot in the staging mode, else the input tensor.
+**/
+/**************************************************************************{{{*/
+uint8_t*
+TflInterp::input_buffer(unsigned int index)
+{
+    return (mSlot.empty() || mSignature) ? reinterpret_cast<uint8_t*>(input(index)->data.raw)
+                                         : mSlot[index][mBack];
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* input tensor of the selected signature
+* @par DESCRIPTION
+*
+**/
+/**************************************************************************{{{*/
+TfLiteTensor*
+TflInterp::input(unsigned int index)
+{
+    return mSignature ? mSignature->input_tensor(mSignature->input_names()[index])
+                      : mInterpreter->input_tensor(index);
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* setup data parallel workers
+* @par DESCRIPTION
+*   build the worker interpreters sharing the FlatBufferModel, each of which
+*   has the input tensors resized to a chunk of the batch. it is not used if
+*   any input/output tensor doesn't have the batch dimension.
+**/
+/**************************************************************************{{{*/
+void
+TflInterp::setup_split(const tflite::OpResolver& resolver, int split, int thread)
+{
+    // all tensors must have the same batch dimension
+    TfLiteTensor* itensor = mInterpreter->input_tensor(0);
+    if (itensor->dims->size < 1 || itensor->dims->data[0] < 2) {
+        return;
+    }
+    int batch = itensor->dims->data[0];
+    for (size_t i = 0; i < mInputCount; i++) {
+        TfLiteTensor* t = mInterpreter->input_tensor(i);
+        if (t->dims->size < 1 || t->dims->data[0] != batch) return;
+    }
+    for (size_t i = 0; i < mOutputCount; i++) {
+        TfLiteTensor* t = mInterpreter->output_tensor(i);
+        if (t->dims->size < 1 || t->dims->data[0] != batch) return;
+    }
+
+    int chunk = (batch + split - 1)/split;
+    for (int offset = 0; offset < batch; offset += chunk) {
+        int n = std::min(chunk, batch - offset);
+
+        std::unique_ptr<tflite::Interpreter> worker;
+        tflite::InterpreterBuilder builder(*mModel, resolver);
+        builder.SetNumThreads(std::max(1, thread/split));
+        builder(&worker);
+
+        for (size_t i = 0; i < mInputCount; i++) {
+            TfLiteTensor* t = mInterpreter->input_tensor(i);
+            std::vector<int> dims(t->dims->data, t->dims->data + t->dims->size);
+            dims[0] = n;
+            worker->ResizeInputTensor(worker->inputs()[i], dims);
+        }
+        if (worker->AllocateTensors() != kTfLiteOk) {
+            std::cerr << "error: AllocateTensors() of split worker\n";
+            mWorker.clear();
+            mWorkerOffset.clear();
+            return;
+        }
+        worker->SetCancellationFunction(this, cancellation);
+
+        mWorker.push_back(std::move(worker));
+        mWorkerOffset.push_back(offset);
+    }
+    mBatch = batch;
+
+    // the workers wait on their own threads for every invoke
+    mWorkerStatus.assign(mWorker.size(), kTfLiteOk);
+    for (size_t k = 0; k < mWorker.size(); k++) {
+        mWorkerThread.emplace_back(&TflInterp::split_loop, this, k);
+    }
 }
 
 /***  Method Header  ******************************************************}}}*/
@@ -71,7 +439,19 @@ TflInterp::TflInterp(std::string tfl_model, int thread)
 *   delate an instance.
 **/
 /**************************************************************************{{{*/
-TflInterp::~TflInterp() {}
+TflInterp::~TflInterp()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mSplitMutex);
+        mSplitStop = true;
+    }
+    mSplitStart.notify_all();
+    for (auto& t : mWorkerThread) {
+        t.join();
+    }
+}
 
 /***  Module Header  ******************************************************}}}*/
 /**
@@ -113,6 +493,40 @@ TflInterp::info(json& res)
         res["outputs"].push_back(tflite_tensor);
     }
 
+    for (const std::string* key : mInterpreter->signature_keys()) {
+        tflite::SignatureRunner* runner = mInterpreter->GetSignatureRunner(key->c_str());
+        if (runner == nullptr) continue;
+
+        json signature;
+        signature["key"] = *key;
+        for (const char* name : runner->input_names()) {
+            signature["inputs"].push_back(name);
+        }
+        for (const char* name : runner->output_names()) {
+            signature["outputs"].push_back(name);
+        }
+        res["signatures"].push_back(signature);
+    }
+    if (mSignature) {
+        res["signature"] = mSignatureKey;
+    }
+
+    if (!mInterpreter->variables().empty()) {
+        json states;
+        states["variables"] = mInterpreter->variables().size();
+        states["size"]      = state_bytes();
+        states["streams"]   = mStates.count();
+        states["arena"]     = mStates.bytes();
+        res["states"] = states;
+    }
+
+    res["split"] = mWorker.size();
+    res["staging"] = mSlot.empty() ? 1 : mSlot[0].size();
+    if (!mBucket.empty()) {
+        res["buckets"]  = mBucketLen;
+        res["seq_axis"] = mSeqAxis;
+    }
+
 #if TFLITE_EXPERIMENTAL
     int first_node_id = mInterpreter->execution_plan()[0];
     const auto& first_node_reg =
@@ -133,8 +547,20 @@ TflInterp::info(json& res)
 int
 TflInterp::set_input_tensor(unsigned int index, const uint8_t* data, int size)
 {
-    TfLiteTensor* itensor = mInterpreter->input_tensor(index);
-    memcpy(itensor->data.raw, data, size);
+    TfLiteTensor* itensor = input(index);
+    size_t bytes = std::min<size_t>(size, itensor->bytes);
+    if (bytes < itensor->bytes) {
+        sync_slot(index);
+    }
+    memcpy(input_buffer(index), data, bytes);
+    mark_fresh(index);
+
+    if (!mSignature && !mBucket.empty() && mSeqInput[index]) {
+        // pad the rest and remember the length of the sequence
+        memset(input_buffer(index) + bytes, 0, itensor->bytes - bytes);
+        size_t row = itensor->bytes/mSeqMax;
+        mSeqLen[index] = (bytes + row - 1)/row;
+    }
 
     return size;
 }
@@ -151,30 +577,284 @@ TflInterp::set_input_tensor(unsigned int index, const uint8_t* data, int size)
 int
 TflInterp::set_input_tensor(unsigned int index, const uint8_t* data, int size, std::function<float(uint8_t)> conv)
 {
-    TfLiteTensor* itensor = mInterpreter->input_tensor(index);
-    float* dst = itensor->data.f;
+    TfLiteTensor* itensor = input(index);
+    size = std::min<int>(size, static_cast<int>(itensor->bytes/sizeof(float)));
+    if (size*sizeof(float) < itensor->bytes) {
+        sync_slot(index);
+    }
+
+    float* dst = reinterpret_cast<float*>(input_buffer(index));
     const uint8_t* src = data;
     for (int i = 0; i < size; i++) {
         *dst++ = conv(*src++);
     }
-    
+    mark_fresh(index);
+
+    if (!mSignature && !mBucket.empty() && mSeqInput[index]) {
+        size_t bytes = size*sizeof(float);
+        memset(input_buffer(index) + bytes, 0, itensor->bytes - bytes);
+        size_t row = itensor->bytes/mSeqMax;
+        mSeqLen[index] = (bytes + row - 1)/row;
+    }
+
     return size;
 }
 
 /***  Module Header  ******************************************************}}}*/
 /**
-* execute inference
+* cancellation check
 * @par DESCRIPTION
+*   the interpreter polls it between the ops. a delegated subgraph (XNNPack)
+*   is one op, so it is not interrupted inside.
 *
-*
-* @retval
+* @retval true  abort Invoke()
 **/
 /**************************************************************************{{{*/
 bool
+TflInterp::cancellation(void* self)
+{
+    return static_cast<TflInterp*>(self)->check_run() != 0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* execute inference
+* @par DESCRIPTION
+*   it returns after Invoke() completes.
+*
+* @retval 0   success
+* @retval <0  error_code {ERR_INVOKE, ERR_DEADLINE, ERR_CANCEL}
+**/
+/**************************************************************************{{{*/
+int
 TflInterp::invoke()
 {
-    mInterpreter->Invoke();
-    return true;
+    wait();
+
+    mStatus = mSignature ? 0 : swap_slots();
+    if (mStatus == 0) {
+        pick_bucket();
+        mStatus = invoke_now();
+    }
+    return mStatus;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* start inference
+* @par DESCRIPTION
+*   in the staging mode, Invoke() runs in the background on the front slot
+*   and it returns at once. the next input goes to the back slot meanwhile,
+*   and reading the output waits for the end of Invoke(). the background run
+*   keeps the deadline and the cancel of this request, and its abort is
+*   reported to the request reading the output.
+*
+* @retval 0   success
+* @retval <0  error_code {ERR_INVOKE, ERR_DEADLINE, ERR_CANCEL}
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::start_invoke()
+{
+    if (mSlot.empty() || mSignature) {
+        return invoke();
+    }
+
+    wait();
+
+    // mStatus belongs to the runner from here on; wait() reads it after join().
+    int status = swap_slots();
+    if (status == 0) {
+        pick_bucket();
+        start_run();
+        mRunner = std::thread([this]() { mStatus = invoke_now(); });
+    }
+    else {
+        mStatus = status;
+    }
+    return status;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* wait for the end of the background Invoke()
+* @par DESCRIPTION
+*
+*
+* @retval status of the last Invoke()
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::wait()
+{
+    if (mRunner.joinable()) {
+        mRunner.join();
+        end_run();
+    }
+    return mStatus;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* wait for the output of the last Invoke()
+* @par DESCRIPTION
+*   the abort of the last Invoke() is the status of the request reading its
+*   output.
+*
+* @retval status of the last Invoke()
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::wait_output()
+{
+    int status = wait();
+    if (status == ERR_DEADLINE || status == ERR_CANCEL) {
+        mAbort = status;
+    }
+    return status;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* execute inference on the current input tensors
+* @par DESCRIPTION
+*
+*
+* @retval 0   success
+* @retval <0  error_code {ERR_INVOKE, ERR_DEADLINE, ERR_CANCEL}
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::invoke_now()
+{
+    if (mSignature) {
+        if (mSignature->Invoke() != kTfLiteOk) {
+            int aborted = run_aborted();
+            return (aborted < 0) ? aborted : static_cast<int>(ERR_INVOKE);
+        }
+        return 0;
+    }
+
+    tflite::Interpreter* interpreter = mInterpreter.get();
+
+    if (mActive >= 0) {
+        // the head of the sequence inputs to the bucket
+        interpreter = mBucket[mActive].get();
+        for (size_t i = 0; i < mInputCount; i++) {
+            const TfLiteTensor* src = mInterpreter->input_tensor(i);
+            TfLiteTensor*       dst = interpreter->input_tensor(i);
+            memcpy(dst->data.raw, src->data.raw, dst->bytes);
+        }
+    }
+    else if (!mWorker.empty()) {
+        return invoke_split();
+    }
+
+    if (interpreter->Invoke() != kTfLiteOk) {
+        int aborted = run_aborted();
+        return (aborted < 0) ? aborted : static_cast<int>(ERR_INVOKE);
+    }
+    return 0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* thread of the split worker
+* @par DESCRIPTION
+*   run the worker "k" every time invoke_split() advances the round.
+**/
+/**************************************************************************{{{*/
+void
+TflInterp::split_loop(size_t k)
+{
+    uint64_t round = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mSplitMutex);
+            mSplitStart.wait(lock, [&]() { return mSplitStop || mSplitRound != round; });
+            if (mSplitStop) {
+                return;
+            }
+            round = mSplitRound;
+        }
+
+        int status = run_worker(k);
+
+        {
+            std::lock_guard<std::mutex> lock(mSplitMutex);
+            mWorkerStatus[k] = status;
+            if (--mSplitPending == 0) {
+                mSplitDone.notify_one();
+            }
+        }
+    }
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* run the chunk of the batch on the worker "k"
+* @par DESCRIPTION
+*   the output of the worker must be the chunk of the output of the main
+*   interpreter, or it is not gathered.
+*
+* @retval kTfLiteOk  success
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::run_worker(size_t k)
+{
+    tflite::Interpreter* worker = mWorker[k].get();
+    const size_t offset = mWorkerOffset[k];
+    const size_t n      = ((k + 1 < mWorkerOffset.size()) ? mWorkerOffset[k + 1] : mBatch) - offset;
+
+    for (size_t i = 0; i < mInputCount; i++) {
+        const TfLiteTensor* src = mInterpreter->input_tensor(i);
+        TfLiteTensor*       dst = worker->input_tensor(i);
+        memcpy(dst->data.raw, src->data.raw + offset*(src->bytes/mBatch), dst->bytes);
+    }
+
+    int status = worker->Invoke();
+    if (status != kTfLiteOk) {
+        return status;
+    }
+
+    for (size_t i = 0; i < mOutputCount; i++) {
+        const TfLiteTensor* src = worker->output_tensor(i);
+        TfLiteTensor*       dst = mInterpreter->output_tensor(i);
+        if (dst->bytes % mBatch != 0 || src->bytes != dst->bytes/mBatch*n) {
+            return kTfLiteError;
+        }
+        memcpy(dst->data.raw + offset*(dst->bytes/mBatch), src->data.raw, src->bytes);
+    }
+    return kTfLiteOk;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* execute inference splitting the batch
+* @par DESCRIPTION
+*   the input tensors of the main interpreter are sliced along the batch into
+*   the workers, the workers run concurrently on their resident threads, and
+*   their results are gathered into the output tensors of the main interpreter.
+*
+* @retval 0   success
+* @retval <0  error_code {ERR_INVOKE, ERR_DEADLINE, ERR_CANCEL}
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::invoke_split()
+{
+    std::unique_lock<std::mutex> lock(mSplitMutex);
+    mSplitPending = mWorker.size();
+    mSplitRound++;
+    mSplitStart.notify_all();
+    mSplitDone.wait(lock, [this]() { return mSplitPending == 0; });
+
+    if (!std::all_of(mWorkerStatus.begin(), mWorkerStatus.end(), [](int x) { return x == kTfLiteOk; })) {
+        int aborted = run_aborted();
+        return (aborted < 0) ? aborted : static_cast<int>(ERR_INVOKE);
+    }
+    return 0;
 }
 
 /***  Module Header  ******************************************************}}}*/
@@ -189,8 +869,366 @@ TflInterp::invoke()
 std::string
 TflInterp::get_output_tensor(unsigned int index)
 {
-    TfLiteTensor* otensor = mInterpreter->output_tensor(index);
-    return std::string(otensor->data.raw, otensor->bytes);
+    if (wait_output() < 0) {
+        return std::string("");
+    }
+
+    const TfLiteTensor* otensor = active_output(index);
+    return std::string(otensor->data.raw, active_bytes(otensor));
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* get the view of the tensor
+* @par DESCRIPTION
+*   fill the view with the reference to the tensor buffer.
+*
+* @retval true  success
+* @retval false unsupported dtype
+**/
+/**************************************************************************{{{*/
+static bool
+tensor_view(const TfLiteTensor* tensor, TensorView& view)
+{
+    switch (tensor->type) {
+    case kTfLiteFloat32: view.mDType = TensorSpec::DTYPE_F32; break;
+    case kTfLiteUInt8:   view.mDType = TensorSpec::DTYPE_U8;  break;
+    case kTfLiteInt8:    view.mDType = TensorSpec::DTYPE_I8;  break;
+    case kTfLiteUInt16:  view.mDType = TensorSpec::DTYPE_U16; break;
+    case kTfLiteInt16:   view.mDType = TensorSpec::DTYPE_I16; break;
+    case kTfLiteInt32:   view.mDType = TensorSpec::DTYPE_I32; break;
+    default:
+        view.mDType = TensorSpec::DTYPE_NONE;
+        return false;
+    }
+
+    view.mShape.assign(tensor->dims->data, tensor->dims->data + tensor->dims->size);
+    view.mData      = reinterpret_cast<uint8_t*>(tensor->data.raw);
+    view.mBytes     = tensor->bytes;
+    view.mScale     = tensor->params.scale;
+    view.mZeroPoint = tensor->params.zero_point;
+
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* get the view of the input tensor
+* @par DESCRIPTION
+*   the length written through the view is unknown, so the sequence input
+*   counts as full length, unless "keep_len" (the caller rewrites the head
+*   of the written sequence only).
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+TflInterp::get_input_view(unsigned int index, TensorView& view, bool keep_len)
+{
+    if (!tensor_view(input(index), view)) {
+        return false;
+    }
+    sync_slot(index);
+    mark_fresh(index);
+    view.mData = input_buffer(index);
+
+    if (!mSignature && !mBucket.empty() && !keep_len) {
+        mSeqLen[index] = mSeqMax;
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* get the view of the result tensor
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+TflInterp::get_output_view(unsigned int index, TensorView& view)
+{
+    if (wait_output() < 0) {
+        return false;
+    }
+
+    const TfLiteTensor* otensor = active_output(index);
+    if (!tensor_view(otensor, view)) {
+        return false;
+    }
+
+    // without the padding
+    size_t bytes = active_bytes(otensor);
+    if (bytes != view.mBytes) {
+        view.mShape[mSeqAxis] = static_cast<int>(mActiveLen);
+        view.mBytes = bytes;
+    }
+    return true;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* size of the input tensor
+* @par DESCRIPTION
+*   "prefix" tells that a shorter write is taken as the head of the sequence
+*   and padded (the sequence input of the bucketing mode).
+*
+* @retval bytes of the input tensor
+**/
+/**************************************************************************{{{*/
+size_t
+TflInterp::input_bytes(unsigned int index, bool* prefix)
+{
+    if (prefix != nullptr) {
+        *prefix = (!mSignature && !mBucket.empty() && mSeqInput[index]);
+    }
+    return input(index)->bytes;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* estimate the memory usage
+* @par DESCRIPTION
+*   the model buffer and the tensors not mapped from it (arena, persistent,
+*   dynamic) of the interpreter and the split workers, and the input slots.
+*   the arena reuses the memory, so it is an upper bound of the tensors.
+*   they are fixed after the load, so they are counted once. the states of
+*   the streams are added as they grow.
+*
+* @retval bytes
+**/
+/**************************************************************************{{{*/
+static size_t
+tensors_bytes(tflite::Interpreter* interpreter)
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < interpreter->tensors_size(); i++) {
+        const TfLiteTensor* t = interpreter->tensor(static_cast<int>(i));
+        if (t->allocation_type != kTfLiteMmapRo) {
+            bytes += t->bytes;
+        }
+    }
+    return bytes;
+}
+
+size_t
+TflInterp::memory_usage()
+{
+    if (!mValid) {
+        return 0;
+    }
+    if (mBaseBytes > 0) {
+        return mBaseBytes + mStates.bytes();
+    }
+
+    size_t bytes = mModel->allocation() ? mModel->allocation()->bytes() : 0;
+    bytes += tensors_bytes(mInterpreter.get());
+    for (auto& worker : mWorker) {
+        bytes += tensors_bytes(worker.get());
+    }
+    for (auto& bucket : mBucket) {
+        bytes += tensors_bytes(bucket.get());
+    }
+    for (auto& mem : mSlotMem) {
+        bytes += mem.size();
+    }
+    mBaseBytes = bytes;
+    return mBaseBytes + mStates.bytes();
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* select the signature
+* @par DESCRIPTION
+*   the following commands work on the inputs/outputs of the signature in
+*   the order of its input/output names. the signatures share the model and
+*   the weights with the primary subgraph. key "" selects the primary
+*   subgraph. the staging and bucketing modes are for the primary subgraph.
+*
+* @retval 0  success
+* @retval -1 no signature
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::select_signature(const std::string& key)
+{
+    wait();
+
+    if (key.empty()) {
+        mSignature    = nullptr;
+        mSignatureKey.clear();
+        mInputCount   = mInterpreter->inputs().size();
+        mOutputCount  = mInterpreter->outputs().size();
+        return 0;
+    }
+
+    tflite::SignatureRunner* runner = mInterpreter->GetSignatureRunner(key.c_str());
+    if (runner == nullptr || runner->AllocateTensors() != kTfLiteOk) {
+        return -1;
+    }
+
+    mSignature    = runner;
+    mSignatureKey = key;
+    mInputCount   = runner->input_size();
+    mOutputCount  = runner->output_size();
+    mActive       = -1;
+    mActiveLen    = 0;
+    return 0;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* bytes of the variable tensors
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+size_t
+TflInterp::state_bytes()
+{
+    size_t bytes = 0;
+    for (int index : mInterpreter->variables()) {
+        bytes += mInterpreter->tensor(index)->bytes;
+    }
+    return bytes;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* can the state be saved/restored?
+* @par DESCRIPTION
+*   the state is in the variable tensors of the primary interpreter. the
+*   split workers, the buckets and the signature runners have their own,
+*   so the state of the stream is not supported in those modes.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+bool
+TflInterp::has_state()
+{
+    return !mInterpreter->variables().empty()
+        && mWorker.empty() && mBucket.empty() && mSignature == nullptr;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* reset the variable tensors to the initial state
+* @par DESCRIPTION
+*
+*
+* @retval 0  success
+* @retval -1 failed, or not supported in the mode
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::reset_state()
+{
+    wait();
+    if (!has_state()) {
+        return -1;
+    }
+    return (mInterpreter->ResetVariableTensors() == kTfLiteOk) ? 0 : -1;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* snapshot the variable tensors as the state of the stream
+* @par DESCRIPTION
+*   the state of the primary interpreter. it overwrites the last snapshot
+*   of the stream.
+*
+* @retval 0  success
+* @retval -1 no variable tensors, or not supported in the mode
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::save_state(uint32_t stream)
+{
+    wait();
+
+    const std::vector<int>& variables = mInterpreter->variables();
+    uint8_t* dst = has_state() ? mStates.acquire(stream, state_bytes()) : nullptr;
+    if (dst == nullptr) {
+        return -1;
+    }
+
+    for (int index : variables) {
+        const TfLiteTensor* tensor = mInterpreter->tensor(index);
+        memcpy(dst, tensor->data.raw, tensor->bytes);
+        dst += tensor->bytes;
+    }
+    return 0;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* restore the variable tensors from the state of the stream
+* @par DESCRIPTION
+*   the new stream starts from the initial state.
+*
+* @retval 0  restored
+* @retval 1  new stream, reset
+* @retval -1 no variable tensors, or not supported in the mode
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::restore_state(uint32_t stream)
+{
+    wait();
+
+    const std::vector<int>& variables = mInterpreter->variables();
+    if (!has_state()) {
+        return -1;
+    }
+
+    const uint8_t* src = mStates.find(stream);
+    if (src == nullptr) {
+        return (mInterpreter->ResetVariableTensors() == kTfLiteOk) ? 1 : -1;
+    }
+
+    for (int index : variables) {
+        TfLiteTensor* tensor = mInterpreter->tensor(index);
+        memcpy(tensor->data.raw, src, tensor->bytes);
+        src += tensor->bytes;
+    }
+    return 0;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* drop the state of the stream
+* @par DESCRIPTION
+*
+*
+* @retval 0  success
+* @retval -1 no state
+**/
+/**************************************************************************{{{*/
+int
+TflInterp::drop_state(uint32_t stream)
+{
+    return mStates.release(stream) ? 0 : -1;
+}
+
+/***  Method Header  ******************************************************}}}*/
+/**
+* does it keep anything a reload would lose?
+* @par DESCRIPTION
+*   the background run whose output is not read yet, the selected signature
+*   and the states of the streams.
+*
+* @retval true  it should stay resident
+**/
+/**************************************************************************{{{*/
+bool
+TflInterp::holds_state()
+{
+    return mRunner.joinable() || mSignature != nullptr || mStates.count() > 0;
 }
 
 /*** tfl_interp.cc ********************************************************}}}*/
@@ -14,6 +14,11 @@
 
 /*--- INCLUDE ---*/
 #include "tiny_ml.h"
+#include "state_arena.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "tensorflow/lite/interpreter.h"
 #include "tensorflow/lite/model.h"
@@ -38,7 +43,7 @@ public:
 
 //LIFECYCLE:
 public:
-  TflInterp(std::string tfl_model, int thread);
+  TflInterp(std::string tfl_model, int thread, int split=1, int slot=1, const std::vector<int>& buckets={}, int seq_axis=1);
   virtual ~TflInterp();
 
 //ACTION:
@@ -46,8 +51,19 @@ public:
     void info(json& res);
     int set_input_tensor(unsigned int index, const uint8_t* data, int size);
     int set_input_tensor(unsigned int index, const uint8_t* data, int size, std::function<float(uint8_t)> conv);
-    bool invoke();
+    int invoke();
+    int start_invoke();
     std::string get_output_tensor(unsigned int index);
+    bool get_input_view(unsigned int index, TensorView& view, bool keep_len=false);
+    bool get_output_view(unsigned int index, TensorView& view);
+    size_t input_bytes(unsigned int index, bool* prefix=nullptr);
+    size_t memory_usage();
+    int select_signature(const std::string& key);
+    int reset_state();
+    int save_state(uint32_t stream);
+    int restore_state(uint32_t stream);
+    int drop_state(uint32_t stream);
+    bool holds_state();
 
 //ACCESSOR:
 public:
@@ -55,10 +71,75 @@ public:
 //INQUIRY:
 public:
 
+//ACTION:
+private:
+    void setup_split(const tflite::OpResolver& resolver, int split, int thread);
+    void split_loop(size_t k);
+    int run_worker(size_t k);
+    int invoke_split();
+    int invoke_now();
+    static bool cancellation(void* self);
+
+    void setup_staging(int slot);
+    void setup_buckets(const tflite::OpResolver& resolver, std::vector<int> buckets, int seq_axis, int thread);
+    void pick_bucket();
+    TfLiteTensor* input(unsigned int index);
+    const TfLiteTensor* active_output(unsigned int index);
+    size_t active_bytes(const TfLiteTensor* tensor);
+    size_t state_bytes();
+    bool has_state();
+    uint8_t* input_buffer(unsigned int index);
+    int  swap_slots();
+    void sync_slot(unsigned int index);
+    void mark_fresh(unsigned int index);
+    int  wait();
+    int  wait_output();
+
 //ATTRIBUTE:
 private:
     std::unique_ptr<tflite::Interpreter> mInterpreter;
     std::unique_ptr<tflite::FlatBufferModel> mModel;
+
+    // data parallel workers sharing mModel: each runs a chunk of the batch
+    std::vector<std::unique_ptr<tflite::Interpreter>> mWorker;
+    std::vector<int> mWorkerOffset;
+    int              mBatch { 1 };
+    std::vector<std::thread> mWorkerThread; // resident thread of each worker
+    std::vector<int> mWorkerStatus;
+    std::mutex       mSplitMutex;
+    std::condition_variable mSplitStart;
+    std::condition_variable mSplitDone;
+    uint64_t         mSplitRound { 0 };     // advanced to start the workers
+    size_t           mSplitPending { 0 };   // workers still running
+    bool             mSplitStop { false };
+
+    // staging mode: input slots [input][slot]. the interpreter runs on the
+    // front slot while the next input is written into the back slot
+    std::vector<std::vector<uint8_t>>  mSlotMem;
+    std::vector<std::vector<uint8_t*>> mSlot;
+    int              mBack { 0 };
+    std::vector<bool> mFresh;       // the back slot has the latest data of the input
+    std::thread      mRunner;       // Invoke() in the background
+    int              mStatus { 0 }; // status of the last Invoke()
+
+    // bucketing mode: interpreters of the shorter sequence lengths sharing
+    // mModel. the shortest one fitting the input runs instead of the full one
+    int              mSeqAxis { 1 };
+    int              mSeqMax { 0 };     // sequence length of the model
+    std::vector<int> mBucketLen;
+    std::vector<std::unique_ptr<tflite::Interpreter>> mBucket;
+    std::vector<bool>   mSeqInput;      // the input has the sequence axis
+    std::vector<size_t> mSeqLen;        // written length of the input
+    int              mActive { -1 };    // bucket of the last invoke, -1 = full length
+    size_t           mActiveLen { 0 };  // sequence length of the last invoke
+
+    // signature selected for the commands, nullptr = primary subgraph
+    tflite::SignatureRunner* mSignature { nullptr };
+    std::string      mSignatureKey;
+
+    // snapshots of the variable tensors of the streams
+    StateArena       mStates;
+    size_t           mBaseBytes { 0 };  // memory usage but the states
 };
 
 /*INLINE METHOD:
@@ -12,9 +12,16 @@
 
 #include <stdio.h>
 #include <fstream>
+#include <thread>
+#include <mutex>
+#include <algorithm>
 
 #include "tiny_ml.h"
 #include "postprocess.h"
+#include "preprocess.h"
+#include "request_queue.h"
+#include "registry.h"
+#include "pipeline.h"
 
 /***  Module Header  ******************************************************}}}*/
 /**
@@ -38,6 +45,25 @@ info(SysInfo& sys, const void*)
     res["thread"]  = sys.mNumThread;
 
     sys.mInterp->info(res);
+    models_info(sys, res);
+
+    if (sys.mQueue) {
+        static const char* policy[] = { "reject", "drop_oldest", "latest" };
+        json queue;
+        queue["depth"]    = sys.mQueue->size();
+        queue["capacity"] = sys.mQueue->depth();
+        queue["policy"]   = policy[sys.mQueue->policy()];
+        queue["dropped"]  = sys.mQueue->dropped();
+        queue["rejected"] = sys.mQueue->rejected();
+        for (const auto& item : sys.mQueue->tenants()) {
+            json tenant;
+            tenant["tenant"] = item.first;
+            tenant["weight"] = item.second.first;
+            tenant["served"] = item.second.second;
+            queue["tenants"].push_back(tenant);
+        }
+        res["queue"] = queue;
+    }
 
     json lap_time;
     lap_time["input"]  = sys.mLap[0].count();
@@ -93,6 +119,19 @@ set_input_tensor(TinyMLInterp* interp, const void* args)
         }
         break;
 
+    case 3:
+        {
+        // the tensor in the store: data = handle
+        const std::string* blob = gSys.find_tensor(*reinterpret_cast<const unsigned int*>(prms->data));
+        TensorView view;
+        if (blob == nullptr
+        || !interp->get_input_view(prms->index, view) || blob->size() > view.mBytes) {
+            return -2;
+        }
+        res = interp->set_input_tensor(prms->index, reinterpret_cast<const uint8_t*>(blob->data()), static_cast<int>(blob->size()));
+        }
+        break;
+
     default:
         return -3;
     }
@@ -117,11 +156,107 @@ set_input_tensor(SysInfo& sys, const void* args)
 
 /***  Module Header  ******************************************************}}}*/
 /**
-* execute inference
+* set a sub-region of input tensor
 * @par DESCRIPTION
+*   overwrite only the slice of the input tensor. the rest keeps the previous
+*   data in the stateful mode.
+*     rank == 0: copy the data at the byte offset.
+*     rank >  0: copy the data to the N-d slice {start[rank], size[rank]}.
 *
+* @retval json  {"status": 0}
+**/
+/**************************************************************************{{{*/
+std::string
+set_input_slice(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int index;
+        unsigned int size;          // bytes of the data
+        unsigned int rank;
+        unsigned int offset;        // byte offset (rank == 0)
+        unsigned int dims[1];       // start[rank], size[rank], followed by the data
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&prms->dims[2*prms->rank]);
+
+    json res;
+
+    TensorView view;
+    if (prms->index >= sys.mInterp->InputCount()
+    || !sys.mInterp->get_input_view(prms->index, view)) {
+        res["status"] = -1;
+        return res.dump();
+    }
+
+    sys.start_watch();
+
+    if (prms->rank == 0) {
+        if (static_cast<size_t>(prms->offset) + prms->size > view.mBytes) {
+            res["status"] = -2;
+            return res.dump();
+        }
+        memcpy(view.mData + prms->offset, data, prms->size);
+    }
+    else {
+        const size_t rank  = prms->rank;
+        const size_t esize = view.element_size();
+        if (rank != view.mShape.size() || esize == 0) {
+            res["status"] = -2;
+            return res.dump();
+        }
+
+        std::vector<size_t> start(rank), size(rank), stride(rank);
+        size_t total = esize;
+        for (size_t i = 0; i < rank; i++) {
+            start[i] = prms->dims[i];
+            size[i]  = prms->dims[rank + i];
+            if (size[i] == 0 || start[i] + size[i] > static_cast<size_t>(view.mShape[i])) {
+                res["status"] = -2;
+                return res.dump();
+            }
+            total *= size[i];
+        }
+        if (total != prms->size) {
+            res["status"] = -2;
+            return res.dump();
+        }
+        stride[rank-1] = esize;
+        for (size_t i = rank-1; i > 0; i--) {
+            stride[i-1] = stride[i]*view.mShape[i];
+        }
+
+        // copy the contiguous runs along the last axis
+        const size_t run = size[rank-1]*esize;
+        std::vector<size_t> pos(rank, 0);
+        for (const uint8_t* src = data; src < data + total; src += run) {
+            size_t offset = 0;
+            for (size_t i = 0; i < rank; i++) {
+                offset += (start[i] + pos[i])*stride[i];
+            }
+            memcpy(view.mData + offset, src, run);
+
+            for (size_t i = rank-1; i > 0; i--) {
+                if (++pos[i-1] < size[i-1]) break;
+                pos[i-1] = 0;
+            }
+        }
+    }
+
+    sys.LAP_INPUT();
+
+    res["status"] = 0;
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* execute inference
+* @par DESCRIPTION
+*   in the staging mode, it returns as soon as Invoke() starts, and the
+*   next input can be set meanwhile.
 *
-* @retval
+* @retval json  {"status": 0} - status < 0: error_code {-11..-13}
 **/
 /**************************************************************************{{{*/
 std::string
@@ -131,7 +266,7 @@ invoke(SysInfo& sys, const void*)
 
     sys.start_watch();
 
-    res["status"] = sys.mInterp->invoke();
+    res["status"] = sys.mInterp->start_invoke();
 
     sys.LAP_EXEC();
 
@@ -170,15 +305,17 @@ get_output_tensor(SysInfo& sys, const void* args)
 
 /***  Module Header  ******************************************************}}}*/
 /**
-* execute inference in session mode
+* execute one inference in session mode
 * @par DESCRIPTION
+*   set the input tensors at "ptr", invoke and append the output tensors to
+*   "output". "ptr" is advanced to the next session even if it fails.
 *
-*
-* @retval
+* @retval 0  success
+* @retval <0 error_code {-1..-3: input tensors, -11..-13: invoke}
 **/
 /**************************************************************************{{{*/
-std::string
-run(SysInfo& sys, const void* args)
+static int
+run_session(SysInfo& sys, const unsigned char*& ptr, std::string& output)
 {
     // set input tensors
     PACK(
@@ -186,35 +323,39 @@ run(SysInfo& sys, const void* args)
         unsigned int  count;
         unsigned char data[1];
     });
-    const Prms* prms = reinterpret_cast<const Prms*>(args);
+    const Prms* prms = reinterpret_cast<const Prms*>(ptr);
 
     sys.start_watch();
 
-    const unsigned char* ptr = prms->data;
+    int status = 0;
+    ptr = prms->data;
     for (unsigned int i = 0; i < prms->count; i++) {
-        int next = set_input_tensor(sys.mInterp, ptr);
+        int next = (status < 0) ? -1 : set_input_tensor(sys.mInterp, ptr);
         if (next < 0) {
-            // error about input tensors: error_code {-1..-3}
-            return std::string(reinterpret_cast<char*>(&next), sizeof(next));
+            // skip the input tensor: <<size::little-integer-32, ..>>
+            status = (status < 0) ? status : next;
+            next = sizeof(unsigned int) + *reinterpret_cast<const unsigned int*>(ptr);
         }
 
         ptr += next;
     }
+    if (status < 0) {
+        return status;
+    }
 
     sys.LAP_INPUT();
 
     // invoke
-    if (!sys.mInterp->invoke()) {
-        // error about invoke: error_code {-11..}
-        int status = -11;
-        return std::string(reinterpret_cast<char*>(&status), sizeof(status));
+    status = sys.mInterp->invoke();
+    if (status < 0) {
+        return status;
     }
 
     sys.LAP_EXEC();
 
     // get output tensors  <<count::little-integer-32, size::little-integer-32, bin::binary-size(size), ..>>
     uint32_t count = static_cast<uint32_t>(sys.mInterp->OutputCount());
-    std::string output(reinterpret_cast<char*>(&count), sizeof(count));
+    output += std::string(reinterpret_cast<char*>(&count), sizeof(count));
 
     for (uint32_t index = 0; index < count; index++) {
         std::string&& otensor = sys.mInterp->get_output_tensor(index);
@@ -225,9 +366,474 @@ run(SysInfo& sys, const void* args)
 
     sys.LAP_OUTPUT();
 
+    return 0;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* execute inference in session mode
+* @par DESCRIPTION
+*
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+std::string
+run(SysInfo& sys, const void* args)
+{
+    const unsigned char* ptr = reinterpret_cast<const unsigned char*>(args);
+    std::string output;
+
+    int status = run_session(sys, ptr, output);
+    if (status < 0) {
+        // error_code {-1..-3, -11..-13}
+        return std::string(reinterpret_cast<char*>(&status), sizeof(status));
+    }
+
     return output;
 }
 
+/***  Module Header  ******************************************************}}}*/
+/**
+* execute multiple inferences in session mode
+* @par DESCRIPTION
+*   run N sessions back-to-back in one request and return all outputs in
+*   one reply. it amortizes the round trip for bulk scoring.
+*
+* @retval binary  <<num::32, {count::s32, {size::32, bin}..}..>> - count < 0: error_code
+**/
+/**************************************************************************{{{*/
+std::string
+run_many(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int  num;
+        unsigned char data[1];
+    });
+    const Prms* prms = reinterpret_cast<const Prms*>(args);
+
+    uint32_t num = prms->num;
+    std::string output(reinterpret_cast<char*>(&num), sizeof(num));
+
+    const unsigned char* ptr = prms->data;
+    for (uint32_t i = 0; i < num; i++) {
+        int status = run_session(sys, ptr, output);
+        if (status < 0) {
+            output += std::string(reinterpret_cast<char*>(&status), sizeof(status));
+        }
+    }
+
+    return output;
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* select the signature of the model
+* @par DESCRIPTION
+*   the following commands to the model work on the signature "key".
+*   the index of the inputs/outputs is in the order of the signature's
+*   input/output names. key "" selects the primary subgraph.
+*
+* @retval json  {"status": 0|-1}
+**/
+/**************************************************************************{{{*/
+std::string
+set_signature(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int size;
+        char         key[1];
+    });
+    const Prms* prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    res["status"] = sys.mInterp->select_signature(std::string(prms->key, prms->size));
+    return res.dump();
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* write a scalar to the first element of the tensor
+* @par DESCRIPTION
+*   quantize it if the tensor is quantized.
+*
+* @retval
+**/
+/**************************************************************************{{{*/
+static void
+put_scalar(TensorView& view, int value)
+{
+    float q = (view.mScale != 0.0f) ? value/view.mScale + view.mZeroPoint : value;
+
+    switch (view.mDType) {
+    case TensorSpec::DTYPE_F32: *reinterpret_cast<float*>(view.mData)    = static_cast<float>(value); break;
+    case TensorSpec::DTYPE_U8:  *reinterpret_cast<uint8_t*>(view.mData)  = static_cast<uint8_t>(q);   break;
+    case TensorSpec::DTYPE_I8:  *reinterpret_cast<int8_t*>(view.mData)   = static_cast<int8_t>(q);    break;
+    case TensorSpec::DTYPE_U16: *reinterpret_cast<uint16_t*>(view.mData) = static_cast<uint16_t>(q);  break;
+    case TensorSpec::DTYPE_I16: *reinterpret_cast<int16_t*>(view.mData)  = static_cast<int16_t>(q);   break;
+    case TensorSpec::DTYPE_I32: *reinterpret_cast<int32_t*>(view.mData)  = static_cast<int32_t>(q);   break;
+    default: break;
+    }
+}
+
+/***  Function Header  ****************************************************}}}*/
+/**
+* pick the next token from the output tensor
+* @par DESCRIPTION
+*   the greedy argmax over the last axis of the last row (logits), or the
+*   value itself if the last axis is 1 (token id).
+*
+* @retval token id, -1 if unknown type
+**/
+/**************************************************************************{{{*/
+static int
+pick_token(const TensorView& view)
+{
+    std::vector<float> value = view.to_float();
+    size_t width = view.mShape.empty() ? 1 : view.mShape.back();
+    if (value.empty() || width == 0) {
+        return -1;
+    }
+    if (width == 1) {
+        return static_cast<int>(value.back());
+    }
+
+    auto row = value.end() - width;
+    return static_cast<int>(std::max_element(row, value.end()) - row);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* autoregressive loop
+* @par DESCRIPTION
+*   invoke up to "max_steps" times, feeding the outputs back to the inputs
+*   between the steps without leaving the process:
+*    - the token picked from "token_output" is appended to the sequence and
+*      written to "token_input". the loop ends at "stop_token".
+*    - the position "pos + step" is written to "pos_input".
+*    - "output -> input" bindings copy the tensors (KV caches, states).
+*   the first step takes the inputs set beforehand, and the inputs not fed
+*   back keep them through the steps (in the staging mode as well). the
+*   sequence length of the bucketing mode follows the fed back outputs. the
+*   last outputs stay in the interpreter for get_output_tensor.
+*   index NONE (0xFFFFFFFF) disables token_output/token_input/pos_input;
+*   token_input needs token_output.
+*
+* @retval binary  <<count::s32, token::s32 * count>> - count < 0: error_code
+**/
+/**************************************************************************{{{*/
+std::string
+loop(SysInfo& sys, const void* args)
+{
+    const unsigned int NONE = 0xFFFFFFFF;
+    PACK(
+    struct Prms {
+        unsigned int max_steps;
+        unsigned int token_output;
+        unsigned int token_input;
+        int          stop_token;
+        unsigned int pos_input;
+        int          pos;
+        unsigned int num_binding;
+        struct {
+            unsigned int output;
+            unsigned int input;
+        } binding[1];
+    });
+    const Prms* prms = reinterpret_cast<const Prms*>(args);
+
+    auto error = [](int status) {
+        return std::string(reinterpret_cast<char*>(&status), sizeof(status));
+    };
+
+    TinyMLInterp* interp = sys.mInterp;
+    unsigned int num_input  = static_cast<unsigned int>(interp->InputCount());
+    unsigned int num_output = static_cast<unsigned int>(interp->OutputCount());
+    if ((prms->token_output != NONE && prms->token_output >= num_output)
+    ||  (prms->token_input  != NONE && prms->token_input  >= num_input)
+    ||  (prms->pos_input    != NONE && prms->pos_input    >= num_input)
+    ||  (prms->token_input  != NONE && prms->token_output == NONE)) {
+        // the token to feed back comes from token_output only
+        return error(-1);
+    }
+    for (unsigned int i = 0; i < prms->num_binding; i++) {
+        if (prms->binding[i].output >= num_output || prms->binding[i].input >= num_input) {
+            return error(-1);
+        }
+    }
+
+    sys.start_watch();
+
+    std::vector<int32_t> tokens;
+    for (unsigned int step = 0; step < prms->max_steps; step++) {
+        if (step > 0) {
+            // feed back the outputs of the previous step. the output cut to
+            // the sequence length (bucketing) sets the length of the input
+            for (unsigned int i = 0; i < prms->num_binding; i++) {
+                TensorView src;
+                if (!interp->get_output_view(prms->binding[i].output, src)) {
+                    return error(-2);
+                }
+                interp->set_input_tensor(prms->binding[i].input, src.mData, static_cast<int>(src.mBytes));
+            }
+
+            TensorView view;
+            if (prms->token_input != NONE) {
+                if (!interp->get_input_view(prms->token_input, view, true)) { return error(-2); }
+                put_scalar(view, tokens.back());
+            }
+            if (prms->pos_input != NONE) {
+                if (!interp->get_input_view(prms->pos_input, view, true)) { return error(-2); }
+                put_scalar(view, prms->pos + step);
+            }
+        }
+
+        int status = interp->invoke();
+        if (status < 0) {
+            return error(status);
+        }
+
+        if (prms->token_output != NONE) {
+            TensorView view;
+            if (!interp->get_output_view(prms->token_output, view)) {
+                return error(-2);
+            }
+            int token = pick_token(view);
+            if (token < 0) {
+                return error(-2);
+            }
+            tokens.push_back(token);
+            if (token == prms->stop_token) {
+                break;
+            }
+        }
+    }
+
+    sys.LAP_EXEC();
+
+    int32_t count = static_cast<int32_t>(tokens.size());
+    return std::string(reinterpret_cast<char*>(&count), sizeof(count))
+         + std::string(reinterpret_cast<char*>(tokens.data()), count*sizeof(int32_t));
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* reset the recurrent state
+* @par DESCRIPTION
+*   reset the variable tensors of the model to the initial state.
+*
+* @retval json  {"status": 0|-1}
+**/
+/**************************************************************************{{{*/
+std::string
+reset_state(SysInfo& sys, const void*)
+{
+    json res;
+    res["status"] = sys.mInterp->reset_state();
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* save/restore/drop the recurrent state of the stream
+* @par DESCRIPTION
+*   the variable tensors of the model are kept per stream, so the streams
+*   time-share one interpreter: restore_state, invoke.., save_state.
+*   the unknown stream is restored to the initial state (status 1).
+*
+* @retval json  {"status": 0|1|-1}
+**/
+/**************************************************************************{{{*/
+std::string
+save_state(SysInfo& sys, const void* args)
+{
+    struct Prms {
+        unsigned int stream;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    res["status"] = sys.mInterp->save_state(prms->stream);
+    return res.dump();
+}
+
+std::string
+restore_state(SysInfo& sys, const void* args)
+{
+    struct Prms {
+        unsigned int stream;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    res["status"] = sys.mInterp->restore_state(prms->stream);
+    return res.dump();
+}
+
+std::string
+drop_state(SysInfo& sys, const void* args)
+{
+    struct Prms {
+        unsigned int stream;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    res["status"] = sys.mInterp->drop_state(prms->stream);
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* put the tensor to the store
+* @par DESCRIPTION
+*   keep the flat binary under the handle. it crosses the port only once.
+*
+* @retval json  {"status": 0}
+**/
+/**************************************************************************{{{*/
+std::string
+put_tensor(SysInfo& sys, const void* args)
+{
+    PACK(
+    struct Prms {
+        unsigned int handle;
+        unsigned int size;
+        uint8_t      data[1];
+    });
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    sys.mTensorStore[prms->handle].assign(reinterpret_cast<const char*>(prms->data), prms->size);
+
+    res["status"] = 0;
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* bind the stored tensor to the input tensor
+* @par DESCRIPTION
+*   copy the tensor in the store to the input tensor. in the stateful mode,
+*   the input keeps it across invokes until it is overwritten.
+*
+* @retval json  {"status": 0}
+**/
+/**************************************************************************{{{*/
+std::string
+bind_input(SysInfo& sys, const void* args)
+{
+    struct Prms {
+        unsigned int index;
+        unsigned int handle;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    const std::string* blob = sys.find_tensor(prms->handle);
+    TensorView view;
+    if (prms->index >= sys.mInterp->InputCount()
+    || !sys.mInterp->get_input_view(prms->index, view)) {
+        res["status"] = -1;
+    }
+    else if (blob == nullptr || blob->size() > view.mBytes) {
+        res["status"] = -2;
+    }
+    else {
+        sys.start_watch();
+        sys.mInterp->set_input_tensor(prms->index, reinterpret_cast<const uint8_t*>(blob->data()), static_cast<int>(blob->size()));
+        sys.LAP_INPUT();
+        res["status"] = 0;
+    }
+
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* keep the result tensor in the store
+* @par DESCRIPTION
+*   copy the output tensor to the store instead of returning it.
+*
+* @retval json  {"status": 0, "size": bytes}
+**/
+/**************************************************************************{{{*/
+std::string
+keep_output(SysInfo& sys, const void* args)
+{
+    struct Prms {
+        unsigned int index;
+        unsigned int handle;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+
+    if (prms->index >= sys.mInterp->OutputCount()) {
+        res["status"] = -1;
+        return res.dump();
+    }
+
+    sys.start_watch();
+
+    std::string& blob = sys.mTensorStore[prms->handle];
+    blob = sys.mInterp->get_output_tensor(prms->index);
+
+    sys.LAP_OUTPUT();
+
+    res["status"] = 0;
+    res["size"]   = blob.size();
+    return res.dump();
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* get the tensor in the store
+* @par DESCRIPTION
+*
+*
+* @retval binary  flat binary of the tensor, or empty
+**/
+/**************************************************************************{{{*/
+std::string
+get_tensor(SysInfo& sys, const void* args)
+{
+    struct Prms {
+        unsigned int handle;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    const std::string* blob = sys.find_tensor(prms->handle);
+    return (blob != nullptr) ? *blob : std::string("");
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* drop the tensor from the store
+* @par DESCRIPTION
+*
+*
+* @retval json  {"status": 0}
+**/
+/**************************************************************************{{{*/
+std::string
+drop_tensor(SysInfo& sys, const void* args)
+{
+    struct Prms {
+        unsigned int handle;
+    };
+    const Prms*  prms = reinterpret_cast<const Prms*>(args);
+
+    json res;
+    res["status"] = (sys.mTensorStore.erase(prms->handle) > 0) ? 0 : -1;
+    return res.dump();
+}
+
 /**************************************************************************}}}**
 * command dispatch table
 ***************************************************************************{{{*/
@@ -240,16 +846,140 @@ TMLFunc* gCmdTbl[] = {
     get_output_tensor,
     run,
 
-    POST_PROCESS
+    POST_PROCESS,
+    PRE_PROCESS,
+
+    put_tensor,
+    bind_input,
+    keep_output,
+    get_tensor,
+    drop_tensor,
+    set_input_slice,
+    run_many,
+
+    MODEL_REGISTRY,
+
+    set_signature,
+    loop,
+
+    PIPELINE,
+
+    reset_state,
+    save_state,
+    restore_state,
+    drop_state,
+
+    AUDIO_FRONTEND
 };
 
 const int gMaxCmd = sizeof(gCmdTbl)/sizeof(TMLFunc*);
 
+// out-of-band command: <<CMD_CANCEL::32, target_tag::32>> in the envelope
+const unsigned int CMD_CANCEL = 0xFFFFFFFF;
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* send the reply
+* @par DESCRIPTION
+*   the receiver, the interpreter and the pipeline threads reply, so it is
+*   serialized.
+*   <<tag::32, status::s32, result::binary>>
+**/
+/**************************************************************************{{{*/
+int
+send_reply(uint32_t tag, int32_t status, const std::string& result)
+{
+    static std::mutex mutex;
+
+    std::string packet(reinterpret_cast<char*>(&tag), sizeof(tag));
+    packet += std::string(reinterpret_cast<char*>(&status), sizeof(status));
+    packet += result;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return gSys.mSnd(packet);
+}
+
+/***  Module Header  ******************************************************}}}*/
+/**
+* receive the requests
+* @par DESCRIPTION
+*   runs on its own thread so that the cancel request reaches the server
+*   while Invoke() is running. the cancelled request is removed from the
+*   queue if it is still waiting, otherwise the running Invoke() is aborted.
+*   the request over the queue bound is rejected or drops the older one
+*   according to the queue policy.
+**/
+/**************************************************************************{{{*/
+static void
+receiver(RequestQueue& queue)
+{
+    PACK(
+    struct Envelope {
+        unsigned int tag;
+        unsigned int timeout;       // msec, 0 = no deadline
+        unsigned int stream;        // stream id, 0 = none
+        uint16_t     priority;      // priority class, the larger is served first
+        uint16_t     tenant;        // source of the request for the fair share
+        unsigned int model;         // model id, 0 = the model at the start
+        unsigned int cmd;
+        unsigned int target;        // tag to cancel (CMD_CANCEL only)
+    });
+
+    for (;;) {
+        std::string cmd_line;
+        int n = gSys.mRcv(cmd_line);
+        if (n < static_cast<int>(6*sizeof(unsigned int))) {
+            break;
+        }
+        const Envelope& env = *reinterpret_cast<const Envelope*>(cmd_line.data());
+
+        if (env.cmd == CMD_CANCEL) {
+            if (n < static_cast<int>(sizeof(Envelope))) {
+                continue;
+            }
+            uint32_t target = env.target;
+            bool all = (target == TinyMLInterp::REQ_ALL);
+            bool found = queue.cancel(target, all, [](const Request& req) {
+                send_reply(req.mTag, TinyMLInterp::ERR_CANCEL, std::string(""));
+            });
+            if (all || !found) {
+                cancel_models(target);
+                cancel_pipelines(target);
+            }
+            continue;
+        }
+
+        Request req;
+        req.mTag      = env.tag;
+        req.mStream   = env.stream;
+        req.mPriority = env.priority;
+        req.mTenant   = env.tenant;
+        req.mModel    = env.model;
+        if (env.timeout > 0) {
+            req.mDeadline = chrono::steady_clock::now() + chrono::milliseconds(env.timeout);
+        }
+        req.mCmdLine = cmd_line.substr(5*sizeof(unsigned int));
+        bool admitted = queue.push(std::move(req), [](const Request& item) {
+            send_reply(item.mTag, REQ_DROPPED, std::string(""));
+        });
+        if (!admitted) {
+            send_reply(env.tag, REQ_REJECTED, std::string(""));
+        }
+    }
+
+    queue.close();
+}
+
 /***  Module Header  ******************************************************}}}*/
 /**
 * tensor flow lite interpreter
 * @par DESCRIPTION
-*
+*   request packet: <<tag::32, timeout_ms::32, stream::32, priority::16, tenant::16, model::32, cmd::32, args::binary>>
+*   reply packet:   <<tag::32, status::s32, result::binary>>
+*     status  0: executed, the result is the reply of the command
+*     status <0: skipped/aborted {ERR_DEADLINE, ERR_CANCEL, REQ_DROPPED, REQ_REJECTED, REQ_NO_MODEL, REQ_LOADING,
+*                REQ_RELOADED}
+*   the model at the start is registered as the model id 0.
 **/
 /**************************************************************************{{{*/
 void
@@ -257,52 +987,72 @@ interp(std::string& model, std::string& labels, std::string& inputs, std::string
 {
     init_interp(gSys, model, inputs, outputs);
 
-    // load labels
-    if (labels != "none") {
-        std::string   label;
-        std::ifstream lb_file(labels);
-        if (lb_file.fail()) {
-            std::cerr << "error: Failed to open file\n";
-            exit(1);
-        }
-        while (getline(lb_file, label)) {
-            gSys.mLabel.emplace_back(label);
-        }
-        gSys.mNumClass = gSys.mLabel.size();
+    // register the model with labels as the model id 0
+    if (!add_model(0, gSys.mInterp, model, labels)) {
+        std::cerr << "error: Failed to open file\n";
+        exit(1);
     }
-    else {
-        gSys.mLabel.clear();
-        gSys.mNumClass = 0;
+
+    RequestQueue queue(gSys.mQueueDepth, gSys.mQueuePolicy);
+    for (const auto& item : gSys.mTenantWeight) {
+        queue.set_weight(static_cast<uint16_t>(item.first), item.second);
     }
+    gSys.mQueue = &queue;
+    std::thread rcv_thread(receiver, std::ref(queue));
 
     // REPL
-    for (;;) {
-        // receive command packet
-        std::string cmd_line;
-        int n = gSys.mRcv(cmd_line);
-        if (n <= 0) {
-            break;
-        }
-
+    Request req;
+    while (queue.pop(req)) {
         // command branch
         PACK(
         struct Cmd {
             unsigned int cmd;
             uint8_t        args[1];
         });
-        const Cmd& call = *reinterpret_cast<const Cmd*>(cmd_line.data());
+        const Cmd& call = *reinterpret_cast<const Cmd*>(req.mCmdLine.data());
+        TMLFunc* func = (call.cmd < gMaxCmd) ? gCmdTbl[call.cmd] : nullptr;
+
+        gSys.mTag      = req.mTag;
+        gSys.mDeadline = req.mDeadline;
 
-        std::string&& result = (call.cmd < gMaxCmd) ? gCmdTbl[call.cmd](gSys, call.args)
-                                                     : "unknown command";
+        // the model to serve the request
+        TinyMLInterp* target = nullptr;
+        if (!IS_REGISTRY_CMD(func) && !IS_PIPELINE_CMD(func)) {
+            int status = select_model(gSys, req.mModel);
+            if (status < 0) {
+                send_reply(req.mTag, status, std::string(""));
+                continue;
+            }
+            target = gSys.mInterp;
+            target->set_request(req.mTag, req.mDeadline);
+
+            // skip the request expired in the queue
+            status = target->check_cancel();
+            if (status < 0) {
+                send_reply(req.mTag, status, std::string(""));
+                continue;
+            }
+        }
+
+        std::string&& result = (func != nullptr) ? func(gSys, call.args)
+                                                 : "unknown command";
+        if (gSys.mDeferred) {
+            gSys.mDeferred = false;
+            continue;
+        }
 
         // send the result in JSON string
-        n = gSys.mSnd(result);
-        if (n <= 0) {
+        if (send_reply(req.mTag, (target != nullptr) ? target->aborted() : 0, result) <= 0) {
             break;
         }
     }
 
-    delete gSys.mInterp;
+    rcv_thread.join();
+    gSys.mQueue = nullptr;
+
+    clear_pipelines();
+    clear_models();
+    gSys.mInterp = nullptr;
 }
 
 /*** tiny_ml.cc ***********************************************************}}}*/
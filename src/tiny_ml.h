@@ -14,7 +14,10 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
 #include <functional>
+#include <cstring>
+#include <atomic>
 
 #include <chrono>
 namespace chrono = std::chrono;
@@ -32,6 +35,76 @@ using json = nlohmann::json;
 
 #include "tensor_spec.h"
 
+/***  Class Header  *******************************************************}}}*/
+/**
+* Tensor view
+* @par DESCRIPTION
+*   direct reference to the tensor buffer inside the interpreter.
+*   it is used by the pre/post-processing to avoid copying the tensor.
+**/
+/**************************************************************************{{{*/
+struct TensorView {
+    TensorSpec::DType mDType { TensorSpec::DTYPE_NONE };
+    std::vector<int>  mShape;
+    uint8_t*          mData  { nullptr };
+    size_t            mBytes { 0 };
+    float             mScale { 0.0f };  // quantization parameters
+    int               mZeroPoint { 0 };
+
+    size_t count() const {
+        size_t prod = 1;
+        for (const auto& item : mShape) {
+            prod *= item;
+        }
+        return prod;
+    }
+
+    size_t element_size() const {
+        switch (mDType) {
+        case TensorSpec::DTYPE_F32: return 4;
+        case TensorSpec::DTYPE_U8:  return 1;
+        case TensorSpec::DTYPE_I8:  return 1;
+        case TensorSpec::DTYPE_U16: return 2;
+        case TensorSpec::DTYPE_I16: return 2;
+        case TensorSpec::DTYPE_I32: return 4;
+        default:                    return 0;
+        }
+    }
+
+    // get the elements as float32 (dequantize if needed)
+    std::vector<float> to_float() const {
+        size_t n = count();
+        std::vector<float> res(n);
+        float scale = (mScale != 0.0f) ? mScale : 1.0f;
+        float zero  = (mScale != 0.0f) ? static_cast<float>(mZeroPoint) : 0.0f;
+
+        switch (mDType) {
+        case TensorSpec::DTYPE_F32:
+            memcpy(res.data(), mData, n*sizeof(float));
+            break;
+        case TensorSpec::DTYPE_U8:
+            for (size_t i = 0; i < n; i++) { res[i] = scale*(mData[i] - zero); }
+            break;
+        case TensorSpec::DTYPE_I8:
+            for (size_t i = 0; i < n; i++) { res[i] = scale*(reinterpret_cast<const int8_t*>(mData)[i] - zero); }
+            break;
+        case TensorSpec::DTYPE_U16:
+            for (size_t i = 0; i < n; i++) { res[i] = scale*(reinterpret_cast<const uint16_t*>(mData)[i] - zero); }
+            break;
+        case TensorSpec::DTYPE_I16:
+            for (size_t i = 0; i < n; i++) { res[i] = scale*(reinterpret_cast<const int16_t*>(mData)[i] - zero); }
+            break;
+        case TensorSpec::DTYPE_I32:
+            for (size_t i = 0; i < n; i++) { res[i] = scale*(reinterpret_cast<const int32_t*>(mData)[i] - zero); }
+            break;
+        default:
+            res.clear();
+            break;
+        }
+        return res;
+    }
+};
+
 /***  Class Header  *******************************************************}}}*/
 /**
 * Abstruct Tiny ML Interpreter
@@ -51,18 +124,114 @@ public:
     virtual void info(json& res) = 0;
     virtual int set_input_tensor(unsigned int index, const uint8_t* data, int size) = 0;
     virtual int set_input_tensor(unsigned int index, const uint8_t* data, int size, std::function<float(uint8_t)> conv) = 0;
-    virtual bool invoke() = 0;
+    virtual int invoke() = 0;
+    virtual int start_invoke() { return invoke(); }   // returns before the end if staging
     virtual std::string get_output_tensor(unsigned int index) = 0;
+    // keep_len: the write through the view keeps the sequence length (bucketing)
+    virtual bool get_input_view(unsigned int index, TensorView& view, bool keep_len=false) = 0;
+    virtual bool get_output_view(unsigned int index, TensorView& view) = 0;
+    // bytes of the input. "prefix": a shorter write is padded (bucketing)
+    virtual size_t input_bytes(unsigned int index, bool* prefix=nullptr) = 0;
+    virtual size_t memory_usage() { return 0; }     // estimated bytes resident
+    virtual int select_signature(const std::string& key) { return key.empty() ? 0 : -1; }
+    // recurrent state (variable tensors) of the streams
+    virtual int reset_state() { return -1; }
+    virtual int save_state(uint32_t) { return -1; }
+    virtual int restore_state(uint32_t) { return -1; }
+    virtual int drop_state(uint32_t) { return -1; }
+    // does it keep anything a reload would lose? (pending run, stream states..)
+    virtual bool holds_state() { return false; }
+
+//CANCELLATION:
+public:
+    enum {
+        REQ_NONE     = 0,           // tag of no request
+        REQ_ALL      = 0xFFFFFFFF,  // cancel all requests
+        ERR_INVOKE   = -11,
+        ERR_DEADLINE = -12,
+        ERR_CANCEL   = -13,
+    };
+
+    // start the request "tag". epoch deadline = no deadline
+    void set_request(uint32_t tag, chrono::steady_clock::time_point deadline) {
+        mDeadline = deadline.time_since_epoch().count();
+        mAbort    = 0;
+        mTag      = tag;
+    }
+    // cancel the running request "tag" (called from the receiver thread)
+    void cancel(uint32_t tag) {
+        if (tag == REQ_ALL && mBackground) {
+            mRunAbort = ERR_CANCEL;
+        }
+        mCancelTag = (tag == REQ_ALL) ? mTag.load() : tag;
+    }
+    // should the request in service stop?
+    int check_cancel() {
+        return check_cancel(mTag, mDeadline, mAbort);
+    }
+    // the status of the aborted request: 0, ERR_DEADLINE or ERR_CANCEL
+    int aborted() { return mAbort; }
+
+    // the run in the background keeps the request which started it, while
+    // the next requests are served. it is polled between the ops
+    void start_run() {
+        mRunTag      = mTag.load();
+        mRunDeadline = mDeadline.load();
+        mRunAbort    = 0;
+        mBackground  = true;
+    }
+    void end_run() { mBackground = false; }
+    int check_run() {
+        return mBackground ? check_cancel(mRunTag, mRunDeadline, mRunAbort) : check_cancel();
+    }
+    int run_aborted() { return mBackground ? mRunAbort.load() : mAbort.load(); }
+
+protected:
+    int check_cancel(uint32_t tag, chrono::steady_clock::rep deadline, std::atomic<int>& abort) {
+        if (tag == mCancelTag) {
+            abort = ERR_CANCEL;
+        }
+        else if (deadline != 0 && chrono::steady_clock::now().time_since_epoch().count() > deadline) {
+            abort = ERR_DEADLINE;
+        }
+        return abort;
+    }
 
 //INQUIRY:
 public:
     size_t InputCount()  { return mInputCount;  }
     size_t OutputCount() { return mOutputCount; }
+    bool   valid()       { return mValid;       }
+    // writes into the input "index" so far (is a cached content still there?)
+    uint64_t input_writes(unsigned int index) {
+        return (index < mInputWrites.size()) ? mInputWrites[index] : 0;
+    }
+
+protected:
+    void count_write(unsigned int index) {
+        if (index >= mInputWrites.size()) {
+            mInputWrites.resize(index + 1, 0);
+        }
+        mInputWrites[index]++;
+    }
 
 //ATTRIBUTE:
 protected:
-    size_t mInputCount;
-    size_t mOutputCount;
+    size_t mInputCount { 0 };
+    size_t mOutputCount { 0 };
+    bool   mValid { true };     // false if the model failed to load
+    std::vector<uint64_t> mInputWrites;
+
+    std::atomic<uint32_t> mTag { REQ_NONE };
+    std::atomic<uint32_t> mCancelTag { REQ_NONE };
+    std::atomic<int>      mAbort { 0 };
+    std::atomic<chrono::steady_clock::rep> mDeadline { 0 };    // 0 = no deadline
+
+    // the request of the run in the background
+    std::atomic<bool>     mBackground { false };
+    uint32_t              mRunTag { REQ_NONE };
+    chrono::steady_clock::rep mRunDeadline { 0 };
+    std::atomic<int>      mRunAbort { 0 };
 };
 
 /**************************************************************************}}}**
@@ -70,6 +239,8 @@ protected:
 ***************************************************************************{{{*/
 #define NUM_LAP 10
 
+class RequestQueue;
+
 struct SysInfo {
     std::string     mRuntime;   // runtime name & version
     std::string     mExe;       // path of this executable
@@ -77,18 +248,39 @@ struct SysInfo {
     std::string     mLabelPath; // path of Class Labels
     unsigned long   mDiag;      // diagnosis mode
     int             mNumThread; // number of thread
+    int             mNumSplit;  // number of interpreters to split the batch
+    int             mNumSlot;   // input slots of the staging mode, 1 = off
+    size_t          mMemBudget; // memory budget of the models in bytes, 0 = unlimited
+    std::vector<int> mBuckets;  // sequence lengths of the bucketing mode
+    int             mSeqAxis;   // sequence axis of the bucketing mode
+    int             mQueueDepth;    // bound of the request queue, 0 = unbounded
+    int             mQueuePolicy;   // QueuePolicy
+    std::map<unsigned int, double> mTenantWeight;   // fair share of the tenants
+
+    RequestQueue* mQueue{nullptr};
+    uint32_t        mTag{0};    // the request in service
+    chrono::steady_clock::time_point mDeadline;
+    bool            mDeferred{false};   // the command replies later by itself
 
     TinyMLInterp* mInterp{nullptr};
 
-    std::vector<std::string> mLabel;
+    const std::vector<std::string>* mLabel{nullptr};    // labels of the selected model
     size_t mNumClass;
 
+    // tensor store: reusable tensors kept under the handle
+    std::map<unsigned int, std::string> mTensorStore;
+
+    const std::string* find_tensor(unsigned int handle) {
+        auto it = mTensorStore.find(handle);
+        return (it != mTensorStore.end()) ? &it->second : nullptr;
+    }
+
     // i/o method
     int (*mRcv)(std::string& cmd_line);
     int (*mSnd)(std::string result);
 
     std::string label(size_t id) {
-        return (id < mLabel.size()) ? mLabel[id] : std::to_string(id);
+        return (mLabel && id < mLabel->size()) ? (*mLabel)[id] : std::to_string(id);
     }
 
     // stop watch
@@ -120,11 +312,13 @@ extern SysInfo gSys;
 ***************************************************************************{{{*/
 int rcv_packet_port(std::string& cmd_line);
 int snd_packet_port(std::string result);
+int send_reply(uint32_t tag, int32_t status, const std::string& result);
 
 /**************************************************************************}}}**
 * service call functions
 ***************************************************************************{{{*/
 void interp(std::string& model, std::string& labels, std::string& inputs, std::string& outputs);
 void init_interp(SysInfo& sys, std::string& model, std::string& inputs, std::string& outputs);
+TinyMLInterp* create_interp(SysInfo& sys, std::string& model, int thread, int split, int slot);
 
 #endif /* _TINY_ML_H */
@@ -0,0 +1,135 @@
+defmodule TflInterpProtocolTest do
+  use ExUnit.Case
+
+  # the request/reply protocol against the built tfl_interp and the test model
+  # (efficientnet_lite0: u8[1,224,224,3] -> u8[1,5])
+  @moduletag :port
+
+  @input_size 224*224*3
+  @dark  :binary.copy(<<0>>,   @input_size)
+  @light :binary.copy(<<255>>, @input_size)
+
+  defmodule Plain do
+    use TflInterp, model: "test/model.tflite"
+  end
+
+  defmodule Staged do
+    use TflInterp, model: "test/model.tflite", opts: "-s 2"
+  end
+
+  defmodule Reject do
+    use TflInterp, model: "test/model.tflite", opts: "-q 1 -p reject"
+  end
+
+  defmodule DropOldest do
+    use TflInterp, model: "test/model.tflite", opts: "-q 1 -p drop_oldest"
+  end
+
+  defmodule Latest do
+    use TflInterp, model: "test/model.tflite", opts: "-p latest"
+  end
+
+  defp predict(mod, bin) do
+    mod
+    |> TflInterp.set_input_tensor(0, bin)
+    |> TflInterp.invoke()
+    |> TflInterp.get_output_tensor(0)
+  end
+
+  # "count" requests of the session at once, each running "wrap"
+  defp burst(mod, count, wrap \\ fn fun -> fun.() end) do
+    for i <- 1..count do
+      bin = if rem(i, 2) == 0, do: @dark, else: @light
+      Task.async(fn ->
+        wrap.(fn ->
+          mod.session()
+          |> TflInterp.set_input_tensor(0, bin)
+          |> TflInterp.invoke()
+        end)
+      end)
+    end
+  end
+
+  defp served?(%TflInterp{}), do: true
+  defp served?(_), do: false
+
+  describe "staging" do
+    test "each invoke takes its own input" do
+      start_supervised!(Plain)
+      start_supervised!(Staged)
+
+      dark  = predict(Staged, @dark)
+      light = predict(Staged, @light)
+      assert dark != light
+
+      # the same results as without the staging
+      assert dark  == predict(Plain, @dark)
+      assert light == predict(Plain, @light)
+      assert dark  == predict(Staged, @dark)
+    end
+  end
+
+  describe "cancel and deadline" do
+    test "an expired request replies :deadline" do
+      start_supervised!(Plain)
+
+      results = burst(Plain, 8, &TflInterp.with_deadline(1, &1)) |> Task.await_many(60_000)
+      assert Enum.any?(results, &match?({:error, :deadline}, &1))
+    end
+
+    test "cancel replies :cancelled and the next request is served" do
+      start_supervised!(Plain)
+
+      tasks = burst(Plain, 16)
+      Process.sleep(10)
+      TflInterp.cancel(Plain)
+
+      results = Task.await_many(tasks, 60_000)
+      assert Enum.any?(results, &match?({:error, :cancelled}, &1))
+      assert served?(Plain.session() |> TflInterp.set_input_tensor(0, @dark) |> TflInterp.invoke())
+    end
+  end
+
+  describe "queue policy" do
+    test "reject" do
+      start_supervised!(Reject)
+
+      results = burst(Reject, 8) |> Task.await_many(60_000)
+      assert Enum.any?(results, &match?({:error, :rejected}, &1))
+      assert Enum.any?(results, &served?/1)
+    end
+
+    test "drop_oldest" do
+      start_supervised!(DropOldest)
+
+      results = burst(DropOldest, 8) |> Task.await_many(60_000)
+      assert Enum.any?(results, &match?({:error, :dropped}, &1))
+      assert Enum.any?(results, &served?/1)
+    end
+
+    test "latest" do
+      start_supervised!(Latest)
+
+      results = burst(Latest, 8, &TflInterp.with_stream(1, &1)) |> Task.await_many(60_000)
+      assert Enum.any?(results, &match?({:error, :dropped}, &1))
+      assert Enum.any?(results, &served?/1)
+    end
+  end
+
+  describe "loop" do
+    test "feeds the argmax of each step" do
+      start_supervised!(Plain)
+
+      output = predict(Plain, @light) |> :binary.bin_to_list()
+      argmax = Enum.find_index(output, &(&1 == Enum.max(output)))
+
+      assert {:ok, [^argmax, ^argmax, ^argmax]} = TflInterp.loop(Plain, max_steps: 3, token_output: 0)
+    end
+
+    test "token_input needs token_output" do
+      start_supervised!(Plain)
+
+      assert {:error, -1} = TflInterp.loop(Plain, max_steps: 2, token_input: 0)
+    end
+  end
+end